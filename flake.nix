@@ -10,17 +10,28 @@
   in {
     packages.${system}.default = pkgs.stdenv.mkDerivation {
       name = "chip8";
-      src = ./src;
+      src = ./.;
 
       buildInputs = [pkgs.SDL2];
 
       buildPhase = ''
-        CC -o chip8 chip8.c `sdl2-config --cflags --libs`
+        CC -pthread -o chip8 src/*.c `sdl2-config --cflags --libs`
+        CC -pthread -Isrc -o chip8-bench tools/chip8-bench.c src/chip8.c src/core.c src/debugger.c src/ensemble.c src/movie.c src/state.c src/trace.c src/romdb.c `sdl2-config --cflags --libs`
+        CC -pthread -Isrc -o chip8-batch tools/chip8-batch.c src/core.c src/debugger.c src/fault.c src/halt.c src/branch.c src/image.c src/manifest.c src/movie.c src/state.c src/romdb.c
+        CC -Isrc -o chip8-gen tools/chip8-gen.c
+        CC -pthread -Isrc -o chip8-test tools/chip8-test.c src/core.c src/debugger.c src/manifest.c src/state.c
+        CC -Isrc -o chip8-trace tools/chip8-trace.c src/disasm.c
+        CC -Isrc -o chip8-dis tools/chip8-dis.c src/flowgraph.c src/disasm.c src/core.c src/debugger.c
+        CC -Isrc -o chip8-diff tools/chip8-diff.c src/core.c src/debugger.c src/disasm.c src/ensemble.c src/movie.c src/state.c src/romdb.c
+        CC -Isrc -o chip8-fork tools/chip8-fork.c src/core.c src/debugger.c src/manifest.c src/state.c
+        CC -shared -fPIC -Isrc -o libchip8.so src/bindings.c src/core.c src/debugger.c
       '';
 
       installPhase = ''
         mkdir -p $out/bin
-        cp chip8 $out/bin
+        cp chip8 chip8-batch chip8-bench chip8-gen chip8-test chip8-trace chip8-dis chip8-diff chip8-fork $out/bin
+        mkdir -p $out/lib/python
+        cp python/chip8.py libchip8.so $out/lib/python
       '';
     };
 
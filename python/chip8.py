@@ -0,0 +1,163 @@
+"""Python bindings for the emulator core.
+
+Loads the core as a shared library through ctypes, which releases the GIL
+for the length of every call into it, so threads running emulators of their
+own scale across cores. The framebuffer, ram and registers are memoryviews
+aliasing the live emulator state, numpy.asarray() wraps them without a copy.
+Closing the emulator releases them, and the memory is freed once no array
+made from them is left.
+
+Build the library next to this file, or point CHIP8_LIBRARY at it:
+
+    clang -O2 -shared -fPIC -Isrc -o python/libchip8.so src/bindings.c \\
+        src/core.c src/debugger.c
+"""
+
+import ctypes
+import os
+
+WINDOW_WIDTH = 64
+WINDOW_HEIGHT = 32
+RAM_SIZE = 0x1000
+NUM_REGISTERS = 16
+FRAME_RATE = 60
+
+PROFILES = {"vip": 0, "chip48": 1, "schip": 2, "xochip": 3, "modern": 4}
+
+
+def _load_library():
+    path = os.environ.get("CHIP8_LIBRARY") or os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "libchip8.so")
+    library = ctypes.CDLL(path)
+
+    chip8 = ctypes.c_void_p
+    bytes_of = ctypes.POINTER(ctypes.c_uint8)
+    signatures = {
+        "createChip8": (chip8, [ctypes.c_int]),
+        "destroyChip8": (None, [chip8]),
+        "frameBufferOf": (bytes_of, [chip8]),
+        "ramOf": (bytes_of, [chip8]),
+        "registersOf": (bytes_of, [chip8]),
+        "cyclesOf": (ctypes.c_uint64, [chip8]),
+        "loadRom": (ctypes.c_bool, [chip8, ctypes.c_char_p]),
+        "loadRomData": (ctypes.c_bool, [chip8, ctypes.c_char_p,
+                                        ctypes.c_size_t]),
+        "seedRandom": (None, [chip8, ctypes.c_uint32]),
+        "setKeypadState": (None, [chip8, ctypes.c_uint16]),
+        "runFrame": (None, [chip8, ctypes.c_uint32]),
+        "runBatch": (None, [ctypes.POINTER(chip8), ctypes.c_uint32,
+                            ctypes.c_uint32, ctypes.c_uint32]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(library, name)
+        function.restype = restype
+        function.argtypes = argtypes
+    return library
+
+
+_library = _load_library()
+
+
+class _Memory:
+    """Owns the memory of an emulator, freed along with the last reference."""
+
+    def __init__(self, chip8):
+        self.chip8 = chip8
+
+    def __del__(self):
+        _library.destroyChip8(self.chip8)
+
+
+def _view(memory, pointer, shape):
+    size = 1
+    for dimension in shape:
+        size *= dimension
+    array = (ctypes.c_uint8 * size).from_address(
+        ctypes.addressof(pointer.contents))
+    # Every view, and every array or view made from it, keeps the memory
+    array.owner = memory
+    return memoryview(array).cast("B", shape)
+
+
+class Chip8:
+    """An emulator with a rom loaded, either a path or the rom's bytes."""
+
+    def __init__(self, rom, profile="schip", seed=0,
+                 instructions_per_second=700):
+        self._chip8 = self._memory = None
+        self.frame_buffer = self.ram = self.V = None
+        self._chip8 = _library.createChip8(PROFILES[profile])
+        if not self._chip8:
+            raise MemoryError("failed to allocate the emulator")
+        self._memory = _Memory(self._chip8)
+
+        if isinstance(rom, (bytes, bytearray)):
+            loaded = _library.loadRomData(self._chip8, bytes(rom), len(rom))
+        else:
+            loaded = _library.loadRom(self._chip8, os.fsencode(rom))
+        if not loaded:
+            self.close()
+            raise ValueError("failed to load the rom")
+
+        _library.seedRandom(self._chip8, seed)
+        self.instructions_per_frame = instructions_per_second // FRAME_RATE
+
+        self.frame_buffer = _view(self._memory,
+                                  _library.frameBufferOf(self._chip8),
+                                  (WINDOW_HEIGHT, WINDOW_WIDTH))
+        self.ram = _view(self._memory, _library.ramOf(self._chip8),
+                         (RAM_SIZE,))
+        self.V = _view(self._memory, _library.registersOf(self._chip8),
+                       (NUM_REGISTERS,))
+
+    def _handle(self):
+        if not self._chip8:
+            raise ValueError("operation on a closed emulator")
+        return self._chip8
+
+    @property
+    def cycles(self):
+        return _library.cyclesOf(self._handle())
+
+    def set_keys(self, keys):
+        """Holds down the keys set in the bitmask, bit 0 for key 0."""
+        _library.setKeypadState(self._handle(), keys)
+
+    def run(self, frames=1):
+        """Runs frames without holding the GIL."""
+        _library.runBatch(ctypes.byref(ctypes.c_void_p(self._handle())), 1,
+                          frames, self.instructions_per_frame)
+
+    def close(self):
+        """Closes the emulator and releases its views.
+
+        A view that an array such as numpy.asarray() still uses stays valid
+        along with the memory, which is freed once the array is gone.
+        """
+        for view in (self.frame_buffer, self.ram, self.V):
+            if view is not None:
+                try:
+                    view.release()
+                except BufferError:
+                    pass
+        self.frame_buffer = self.ram = self.V = None
+        self._chip8 = self._memory = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exception):
+        self.close()
+
+
+def run_batch(emulators, frames=1):
+    """Runs frames on every emulator in one call without holding the GIL.
+
+    The emulators share the instructions per frame of the first.
+    """
+    if not emulators:
+        return
+    pointers = (ctypes.c_void_p * len(emulators))(
+        *(emulator._handle() for emulator in emulators))
+    _library.runBatch(pointers, len(emulators), frames,
+                      emulators[0].instructions_per_frame)
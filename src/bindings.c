@@ -0,0 +1,34 @@
+#include "bindings.h"
+
+// std
+#include <stdlib.h>
+
+Chip8 *createChip8(const Profile profile) {
+  Chip8 *chip8 = calloc(1, sizeof(*chip8));
+  if (chip8 == NULL) return NULL;
+
+  resetChip8(chip8);
+  setProfile(chip8, profile);
+  chip8->state = RUNNING;
+
+  return chip8;
+}
+
+void destroyChip8(Chip8 *chip8) { free(chip8); }
+
+uint8_t *frameBufferOf(Chip8 *chip8) { return chip8->frameBuffer; }
+
+uint8_t *ramOf(Chip8 *chip8) { return chip8->ram; }
+
+uint8_t *registersOf(Chip8 *chip8) { return chip8->V; }
+
+uint64_t cyclesOf(const Chip8 *chip8) { return chip8->cycles; }
+
+void runBatch(Chip8 *const *chip8s, const uint32_t count,
+              const uint32_t frames, const uint32_t instructions) {
+  for (uint32_t i = 0; i < count; i++) {
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      runFrame(chip8s[i], instructions);
+    }
+  }
+}
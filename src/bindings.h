@@ -0,0 +1,61 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdint.h>
+
+// Entry points for foreign function interfaces such as ctypes and cffi,
+// which can neither lay out Chip8 nor allocate it. The pointers returned
+// alias the live emulator state, so views over them need no copies
+
+/**
+ * Allocates an emulator, powered on with the profile selected.
+ * @param profile - the quirk profile
+ * @return the emulator, or NULL if allocation failed
+ */
+Chip8* createChip8(const Profile profile);
+
+/**
+ * Frees an emulator allocated by createChip8.
+ * @param chip8 - the emulator state
+ */
+void destroyChip8(Chip8* chip8);
+
+/**
+ * Points to the framebuffer, one byte of 0 or 1 per pixel.
+ * @param chip8 - the emulator state
+ * @return the WINDOW_WIDTH * WINDOW_HEIGHT pixels of the framebuffer
+ */
+uint8_t* frameBufferOf(Chip8* chip8);
+
+/**
+ * Points to the ram.
+ * @param chip8 - the emulator state
+ * @return the RAM_SIZE bytes of ram
+ */
+uint8_t* ramOf(Chip8* chip8);
+
+/**
+ * Points to the registers.
+ * @param chip8 - the emulator state
+ * @return the NUM_REGISTERS registers V[0] to V[F]
+ */
+uint8_t* registersOf(Chip8* chip8);
+
+/**
+ * Counts the instructions executed.
+ * @param chip8 - the emulator state
+ * @return the instructions executed since power on
+ */
+uint64_t cyclesOf(const Chip8* chip8);
+
+/**
+ * Runs frames on every emulator in turn, in a single call so the caller's
+ * lock is released once for the whole batch.
+ * @param chip8s - the emulators
+ * @param count - the number of emulators
+ * @param frames - the number of frames to run on each
+ * @param instructions - the number of instructions per frame
+ */
+void runBatch(Chip8* const* chip8s, const uint32_t count,
+              const uint32_t frames, const uint32_t instructions);
@@ -0,0 +1,139 @@
+#include "branch.h"
+
+// std
+#include <stdlib.h>
+#include <string.h>
+
+// Registers before and after ram, the framebuffer comes first
+#define REGISTERS_BEFORE_RAM (offsetof(Chip8, ram) - offsetof(Chip8, V))
+#define AFTER_RAM (offsetof(Chip8, ram) + RAM_SIZE)
+#define REGISTERS_AFTER_RAM (CHIP8_STATE_SIZE - AFTER_RAM)
+
+_Static_assert(offsetof(Chip8, frameBuffer) == 0 &&
+                   offsetof(Chip8, V) == WINDOW_WIDTH * WINDOW_HEIGHT,
+               "the framebuffer leads the machine state");
+
+static uint8_t *pageOf(Chip8 *chip8, const uint32_t page) {
+  if (page < RAM_PAGES) return &chip8->ram[page * DIRTY_PAGE_SIZE];
+  return &chip8->frameBuffer[(page - RAM_PAGES) * DIRTY_PAGE_SIZE];
+}
+
+static BranchPage *allocatePage(BranchPool *pool) {
+  if (pool->free == NULL) {
+    BranchBlock *block = malloc(sizeof(*block));
+    if (block == NULL) return NULL;
+
+    block->next = pool->blocks;
+    pool->blocks = block;
+    for (uint32_t i = 0; i < BRANCH_BLOCK_PAGES; i++) {
+      block->pages[i].next = pool->free;
+      pool->free = &block->pages[i];
+    }
+  }
+
+  BranchPage *page = pool->free;
+  pool->free = page->next;
+  page->references = 1;
+  pool->used++;
+
+  return page;
+}
+
+static void retainPage(BranchPage *page) {
+  if (page->references != BRANCH_PAGE_PINNED) page->references++;
+}
+
+static void releasePage(BranchPool *pool, BranchPage *page) {
+  if (page->references == BRANCH_PAGE_PINNED || --page->references) return;
+
+  page->next = pool->free;
+  pool->free = page;
+  pool->used--;
+}
+
+static void saveRegisters(Branch *branch, Chip8 *chip8) {
+  const uint8_t *state = (const uint8_t *)chip8;
+  memcpy(branch->registers, &state[offsetof(Chip8, V)], REGISTERS_BEFORE_RAM);
+  memcpy(&branch->registers[REGISTERS_BEFORE_RAM], &state[AFTER_RAM],
+         REGISTERS_AFTER_RAM);
+  chip8->dirtyPages = 0;
+}
+
+bool snapshotBranch(BranchPool *pool, Branch *branch, Chip8 *chip8,
+                    const Branch *base) {
+  for (uint32_t i = 0; i < BRANCH_PAGES; i++) {
+    const uint8_t *data = pageOf(chip8, i);
+
+    // Written pages often end up as they were, a sprite drawn and erased
+    if (base != NULL &&
+        (!(chip8->dirtyPages >> i & 1) ||
+         memcmp(data, base->pages[i]->data, DIRTY_PAGE_SIZE) == 0)) {
+      branch->pages[i] = base->pages[i];
+      retainPage(branch->pages[i]);
+      continue;
+    }
+
+    branch->pages[i] = allocatePage(pool);
+    if (branch->pages[i] == NULL) {
+      while (i--) releasePage(pool, branch->pages[i]);
+      return false;
+    }
+    memcpy(branch->pages[i]->data, data, DIRTY_PAGE_SIZE);
+  }
+
+  saveRegisters(branch, chip8);
+
+  return true;
+}
+
+void pinBranch(Branch *branch, BranchPage *pages, Chip8 *chip8) {
+  for (uint32_t i = 0; i < BRANCH_PAGES; i++) {
+    pages[i] = (BranchPage){.references = BRANCH_PAGE_PINNED};
+    memcpy(pages[i].data, pageOf(chip8, i), DIRTY_PAGE_SIZE);
+    branch->pages[i] = &pages[i];
+  }
+
+  saveRegisters(branch, chip8);
+}
+
+void checkoutBranch(Chip8 *chip8, const Branch *branch, const Branch *loaded) {
+  for (uint32_t i = 0; i < BRANCH_PAGES; i++) {
+    if (loaded != NULL && loaded->pages[i] == branch->pages[i] &&
+        !(chip8->dirtyPages >> i & 1)) {
+      continue;
+    }
+    memcpy(pageOf(chip8, i), branch->pages[i]->data, DIRTY_PAGE_SIZE);
+  }
+
+  uint8_t *state = (uint8_t *)chip8;
+  memcpy(&state[offsetof(Chip8, V)], branch->registers, REGISTERS_BEFORE_RAM);
+  memcpy(&state[AFTER_RAM], &branch->registers[REGISTERS_BEFORE_RAM],
+         REGISTERS_AFTER_RAM);
+  chip8->dirtyPages = 0;
+
+  // The interpreter is host state, reselect it for the restored profile
+  setProfile(chip8, chip8->profile);
+}
+
+void cloneBranch(Branch *clone, const Branch *branch) {
+  *clone = *branch;
+  for (uint32_t i = 0; i < BRANCH_PAGES; i++) {
+    retainPage(clone->pages[i]);
+  }
+}
+
+void releaseBranch(BranchPool *pool, Branch *branch) {
+  for (uint32_t i = 0; i < BRANCH_PAGES; i++) {
+    releasePage(pool, branch->pages[i]);
+    branch->pages[i] = NULL;
+  }
+}
+
+void destroyBranchPool(BranchPool *pool) {
+  while (pool->blocks != NULL) {
+    BranchBlock *next = pool->blocks->next;
+    free(pool->blocks);
+    pool->blocks = next;
+  }
+  *pool = (BranchPool){0};
+}
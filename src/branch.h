@@ -0,0 +1,101 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BRANCH_PAGES (RAM_PAGES + FRAME_PAGES)
+
+// Bytes of machine state outside ram and the framebuffer
+#define BRANCH_REGISTERS_SIZE \
+  (CHIP8_STATE_SIZE - RAM_SIZE - WINDOW_WIDTH * WINDOW_HEIGHT)
+
+// Pages allocated at once when the pool runs dry
+#define BRANCH_BLOCK_PAGES 256
+
+// Reference count of a page owned outside any pool, such as a rom image's.
+// Pinned pages are never counted or recycled, so branches of any pool or
+// thread can share them
+#define BRANCH_PAGE_PINNED UINT32_MAX
+
+// Page of ram or of the framebuffer, shared by every branch holding it
+typedef struct BranchPage {
+  uint32_t references;
+  struct BranchPage* next;
+  uint8_t data[DIRTY_PAGE_SIZE];
+} BranchPage;
+
+typedef struct BranchBlock {
+  struct BranchBlock* next;
+  BranchPage pages[BRANCH_BLOCK_PAGES];
+} BranchBlock;
+
+// Recycles pages through a free list. Reference counts are not atomic, so
+// a pool and its branches belong to one thread
+typedef struct {
+  BranchBlock* blocks;
+  BranchPage* free;
+  uint32_t used;
+} BranchPool;
+
+// Machine state whose ram and framebuffer pages are shared copy-on-write
+// with the branches it was cloned from or snapshotted against, so cloning
+// copies the registers and the page pointers only
+typedef struct {
+  BranchPage* pages[BRANCH_PAGES];
+  uint8_t registers[BRANCH_REGISTERS_SIZE];
+} Branch;
+
+/**
+ * Snapshots the machine state into a branch. Pages the emulator has not
+ * written since the base was checked out, or that hold the same bytes, are
+ * shared with the base. Afterwards the emulator holds the new branch.
+ * @param pool - the page pool
+ * @param branch - the branch to snapshot into
+ * @param chip8 - the emulator state
+ * @param base - the branch last checked out into the emulator, or NULL to
+ * copy every page
+ * @return true if the pages could be allocated, false otherwise
+ */
+bool snapshotBranch(BranchPool* pool, Branch* branch, Chip8* chip8,
+                    const Branch* base);
+
+/**
+ * Snapshots the machine state into pages owned by the caller, which are
+ * pinned and outlive every branch sharing them.
+ * @param branch - the branch to snapshot into
+ * @param pages - BRANCH_PAGES pages to copy the state into
+ * @param chip8 - the emulator state
+ */
+void pinBranch(Branch* branch, BranchPage* pages, Chip8* chip8);
+
+/**
+ * Restores the machine state of a branch, copying only the pages that
+ * differ from the branch the emulator holds.
+ * @param chip8 - the emulator state
+ * @param branch - the branch to check out
+ * @param loaded - the branch the emulator holds, or NULL to copy every page
+ */
+void checkoutBranch(Chip8* chip8, const Branch* branch, const Branch* loaded);
+
+/**
+ * Clones a branch, sharing every page with it.
+ * @param clone - the branch to clone into
+ * @param branch - the branch to clone
+ */
+void cloneBranch(Branch* clone, const Branch* branch);
+
+/**
+ * Drops the branch's references to its pages, recycling the pages no
+ * other branch holds.
+ * @param pool - the page pool
+ * @param branch - the branch
+ */
+void releaseBranch(BranchPool* pool, Branch* branch);
+
+/**
+ * Frees every page of the pool, which must no longer be used by a branch.
+ * @param pool - the page pool
+ */
+void destroyBranchPool(BranchPool* pool);
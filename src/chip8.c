@@ -1,77 +1,62 @@
 #include "chip8.h"
+
+#include "debugger.h"
+#include "movie.h"
+#include "profiler.h"
+#include "state.h"
+#include "trace.h"
 // std
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
-int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    fprintf(stderr, "Usage: chip8 <rom>\n");
-    return EXIT_FAILURE;
-  }
-
-  // Default configuration
+bool replayHeadless(const char *moviePath, const char *romPath,
+                    const char *tracePath) {
   Config config = {0};
   defaultConfig(&config);
 
-  // Initialize SDL and Chip8
-  Sdl sdl = {0};
-  Chip8 chip8 = {0};
+  static Chip8 chip8;
+  Movie movie;
 
-  if (!initSdl(&sdl, &config) || !initChip8(&chip8, &config)) {
-    return EXIT_FAILURE;
+  if (!initChip8(&chip8, &config) || !loadRom(&chip8, romPath) ||
+      !loadMovie(&movie, moviePath)) {
+    return false;
   }
 
-  // Load the ROM
-  if (!loadRom(&chip8, argv[1])) {
-    return EXIT_FAILURE;
+  // Trace the replay, flushed on a crash or once it ends
+  static Trace trace;
+  if (tracePath != NULL) {
+    chip8.trace = &trace;
+    flushTraceOnCrash(&trace, tracePath);
   }
 
-  // Seed the random number generator
-  srand(time(NULL));
-
-  while (chip8.state != QUIT) {
-    // Poll and handle input events
-    handleInput(&chip8);
-
-    // Skip if the emulator is paused
-    if (chip8.state == PAUSED) continue;
-
-    const uint64_t beginFrame = SDL_GetTicks();
-
-    // Uniformly execute instructions per frame
-    for (uint32_t i = 0; i < config.instructionsPerSecond / FRAME_RATE; i++)
-      emulateInstruction(&chip8, &config);
-
-    const uint64_t endFrame = SDL_GetTicks();
-
-    // Delay if finished early to maintain a constant frame rate
-    SDL_Delay(FRAME_DURATION_IN_MS - (beginFrame - endFrame));
-
-    // Update the screen and play audio
-    draw(&sdl, &chip8, &config);
-    sound(&chip8, &sdl);
-
-    // Decrement the delay and sound timers at the rate of 60Hz
-    updateTimers(&chip8);
+  const clock_t begin = clock();
+  const bool exact = replayMovie(&movie, &chip8);
+  const double elapsed = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+  // Emulated time of the recording against the time it took to replay
+  const double frames = (double)movie.header.cycles /
+                        (movie.header.instructionsPerSecond / FRAME_RATE);
+  printf("Replayed %llu cycles(%.0f frames) in %.3fs, %.0fx realtime\n",
+         (unsigned long long)chip8.cycles, frames, elapsed,
+         frames / FRAME_RATE / (elapsed > 0 ? elapsed : 1e-9));
+  printf("Final state %08X: %s\n", checksum(&chip8, CHIP8_STATE_SIZE),
+         exact ? "matches the recording" : "DIVERGED from the recording");
+
+#ifdef CHIP8_PROFILER
+  // Write the profile of the replay next to the rom
+  char profilePath[FILENAME_MAX];
+  snprintf(profilePath, sizeof(profilePath), "%s.profile", romPath);
+  writeProfile(&chip8, profilePath);
+#endif
+
+  if (tracePath != NULL) {
+    flushTrace(&trace, tracePath);
   }
 
-  // Cleanup SDL and Chip8
-  cleanup(&sdl);
-
-  return EXIT_SUCCESS;
-}
+  destroyMovie(&movie);
 
-void defaultConfig(Config *config) {
-  config->scaleFactor = 20;              // Scale the window by 20
-  config->foregroundColor = 0xD169B6FF;  // Pink
-  config->backgroundColor = 0x38374CFF;  // Dark blue
-  config->sampleFrequency = 44100;       // Standard CD quality
-  config->sampleSize = 2048;             // Buffer size in samples
-  config->audioFrequency = 440;          // A4 frequency
-  config->audioAmplitude = 5000;         // Volume
-  config->instructionsPerSecond = 700;   // Emulation speed
-  config->outlines = true;               // Draw outlines
+  return exact;
 }
 
 bool initSdl(Sdl *sdl, Config *config) {
@@ -161,11 +146,6 @@ void squareWave(void *userdata, Uint8 *stream, const int32_t len) {
   }
 }
 
-void updateTimers(Chip8 *chip8) {
-  if (chip8->delayTimer) chip8->delayTimer--;
-  if (chip8->soundTimer) chip8->soundTimer--;
-}
-
 void sound(const Chip8 *chip8, const Sdl *sdl) {
   // Play the audio device if the sound timer is active
   if (chip8->soundTimer) {
@@ -175,66 +155,6 @@ void sound(const Chip8 *chip8, const Sdl *sdl) {
   }
 }
 
-bool initChip8(Chip8 *chip8, const Config *config) {
-  // Initialize the stack pointer to the top of the stack
-  chip8->stackPointer = chip8->stack;
-
-  // Load the font into memory
-  loadFont(chip8);
-
-  chip8->state = RUNNING;
-
-  return true;
-}
-
-void loadFont(Chip8 *chip8) {
-  const uint8_t font[FONT_SIZE] = {
-      0xF0, 0x90, 0x90, 0x90, 0xF0,  // 0
-      0x20, 0x60, 0x20, 0x20, 0x70,  // 1
-      0xF0, 0x10, 0xF0, 0x80, 0xF0,  // 2
-      0xF0, 0x10, 0xF0, 0x10, 0xF0,  // 3
-      0x90, 0x90, 0xF0, 0x10, 0x10,  // 4
-      0xF0, 0x80, 0xF0, 0x10, 0xF0,  // 5
-      0xF0, 0x80, 0xF0, 0x90, 0xF0,  // 6
-      0xF0, 0x10, 0x20, 0x40, 0x40,  // 7
-      0xF0, 0x90, 0xF0, 0x90, 0xF0,  // 8
-      0xF0, 0x90, 0xF0, 0x10, 0xF0,  // 9
-      0xF0, 0x80, 0x80, 0x80, 0xF0,  // C
-      0xE0, 0x90, 0x90, 0x90, 0xE0,  // D
-      0xF0, 0x80, 0xF0, 0x80, 0xF0,  // E
-      0xF0, 0x80, 0xF0, 0x80, 0x80   // F
-  };
-
-  memcpy(&chip8->ram, &font, FONT_SIZE);
-}
-
-bool loadRom(Chip8 *chip8, const char *filePath) {
-  FILE *rom = fopen(filePath, "rb");
-
-  if (rom == NULL) {
-    fprintf(stderr, "Failed to open ROM file: %s\n", filePath);
-    return false;
-  }
-
-  // Chip8 programs start at 0x200
-  const uint32_t programEntryPoint = 0x200;
-
-  // Get the size of the ROM
-  fseek(rom, 0, SEEK_END);
-  const size_t romSize = ftell(rom);
-  rewind(rom);
-
-  // Read the ROM into memory
-  fread(&chip8->ram[programEntryPoint], romSize, 1, rom);
-
-  fclose(rom);
-
-  // Point the program counter to the start of the ROM
-  chip8->programCounter = programEntryPoint;
-
-  return true;
-}
-
 void draw(const Sdl *sdl, Chip8 *chip8, const Config *config) {
   // Don't update the display if the draw flag is not set
   if (!chip8->draw) {
@@ -294,270 +214,11 @@ void clearFrameBuffer(const Sdl *sdl, const Config *config) {
   SDL_RenderClear(sdl->renderer);
 }
 
-void emulateInstruction(Chip8 *chip8, const Config *config) {
-  // Fetch the next instruction
-  nextInstruction(chip8);
-
-  // Instruction decoding
-  switch (chip8->instruction.raw >> 12) {
-    case 0x0:
-      // 0x00E0 clear the screen
-      if (chip8->instruction.kk == 0xE0) {
-        memset(chip8->frameBuffer, 0, sizeof(chip8->frameBuffer));
-        chip8->draw = true;
-      }
-      // 0x00EE return from subroutine by subtracting one from the stackPointer
-      // and then setting the programCounter to the address on top of stock
-      else if (chip8->instruction.kk == 0xEE) {
-        chip8->programCounter = *--chip8->stackPointer;
-      }
-      break;
-    case 0x1:
-      // 0x1NNN jump to instruction nnn
-      chip8->programCounter = chip8->instruction.nnn;
-      break;
-    case 0x2:
-      // 0x2NNN call subroutine at address nnn, store the current
-      // address of the programCounter on top of stack and point
-      // the programCounter to nnn
-      *chip8->stackPointer++ = chip8->programCounter;
-      chip8->programCounter = chip8->instruction.nnn;
-      break;
-    case 0x3:
-      // 0x3XKK skip next instruction if V[X] == KK
-      if (chip8->V[chip8->instruction.x] == chip8->instruction.kk) {
-        chip8->programCounter += 2;
-      }
-      break;
-    case 0x4:
-      // 0x4XKK skip next instruction if V[X] != KK
-      if (chip8->V[chip8->instruction.x] != chip8->instruction.kk) {
-        chip8->programCounter += 2;
-      }
-      break;
-    case 0x5:
-      // 05XY0 skip next instruction if V[X] == V[Y]
-      if (chip8->V[chip8->instruction.x] == chip8->V[chip8->instruction.y]) {
-        chip8->programCounter += 2;
-      }
-      break;
-    case 0x6:
-      // 0x6XKK store the KK in the register V[X]
-      chip8->V[chip8->instruction.x] = chip8->instruction.kk;
-      break;
-    case 0x7:
-      // 0x7XKK add KK and V[X] and store the result in V[X] register
-      chip8->V[chip8->instruction.x] += chip8->instruction.kk;
-      break;
-    case 0x8:
-      switch (chip8->instruction.n) {
-        case 0x0:
-          // 0x8XY0  store the value of V[Y] in V[X]
-          chip8->V[chip8->instruction.x] = chip8->V[chip8->instruction.y];
-          break;
-        case 0x1:
-          // 0x8XY1 perform bitwise or operator on V[X] and V[Y] and
-          // store the result in V[X]
-          chip8->V[chip8->instruction.x] |= chip8->V[chip8->instruction.y];
-          break;
-        case 0x2:
-          // 0x8XY2 perform bitwise and operator on V[X] and V[Y] and
-          // store the result in V[X]
-          chip8->V[chip8->instruction.x] &= chip8->V[chip8->instruction.y];
-          break;
-        case 0x3:
-          // 0x8XY3 perform bitwise or operator on V[X] and V[Y] xor
-          // store the result in V[X]
-          chip8->V[chip8->instruction.x] ^= chip8->V[chip8->instruction.y];
-          break;
-        case 0x4: {
-          // 0x8XY4 add V[X] and V[Y], if the result is greater than 0xFF
-          // then store 1 in V[0xF] otherwise store the lower 8 bits in
-          // the V[X]
-          uint8_t carry = (chip8->V[chip8->instruction.x] +
-                           chip8->V[chip8->instruction.y]) > 0xFF;
-
-          chip8->V[chip8->instruction.x] += chip8->V[chip8->instruction.y];
-          chip8->V[0xF] = carry;
-        } break;
-        case 0x5:
-          // 0x8XY5 store 1 in V[X] if greater than V[Y] otherwise 0
-          chip8->V[0xF] =
-              chip8->V[chip8->instruction.x] > chip8->V[chip8->instruction.y];
-          chip8->V[chip8->instruction.x] -= chip8->V[chip8->instruction.y];
-          break;
-        case 0x6:
-          // 0x8XY6 store 1 in V[F] if the least significant bit in V[X]
-          // is 1 otherwise 0. Then divide the result by 2
-          chip8->V[0xF] = chip8->V[chip8->instruction.x] & 1;
-          chip8->V[chip8->instruction.x] >>= 1;
-          break;
-        case 0x7:
-          // 0x8XY7 store 1 in V[F] if V[X] > V[Y] otherwise 0. Then
-          // subtracting V[Y] from V[X] and store the result in V[X]
-          chip8->V[0xF] =
-              chip8->V[chip8->instruction.y] > chip8->V[chip8->instruction.x];
-          chip8->V[chip8->instruction.x] =
-              chip8->V[chip8->instruction.y] - chip8->V[chip8->instruction.x];
-          break;
-        case 0xE:
-          // 0x8XYE store 1 in V[F] if the most significant bit in V[X]
-          // is 1 otherwise 0
-          chip8->V[0xF] = (chip8->V[chip8->instruction.x] >> 7) & 1;
-          chip8->V[chip8->instruction.x] <<= 1;
-          break;
-      }
-      break;
-    case 0x9:
-      // 0x9XY0 if V[X] != V[Y] skip next instruction
-      if (chip8->V[chip8->instruction.x] != chip8->V[chip8->instruction.y]) {
-        chip8->programCounter += 2;
-      }
-      break;
-    case 0xA:
-      // 0xANNN set the indexRegister to NNN
-      chip8->indexRegister = chip8->instruction.nnn;
-      break;
-    case 0xB:
-      // 0xBNNN jump to instruction at NNN + V[0x0]
-      chip8->programCounter = chip8->instruction.nnn + chip8->V[0x0];
-      break;
-    case 0xC:
-      // 0xCXKK generate a random number between 0 and 255, & it with KK
-      // and store the result in V[X]
-      chip8->V[chip8->instruction.x] = (rand() % 256) & chip8->instruction.kk;
-      break;
-    case 0xD:
-      // 0xDXYN draw a n byte sprite at V[X], V[Y] coordinates
-      // Set V[0xF] to collision detection
-      {
-        uint8_t dx = chip8->V[chip8->instruction.x] % WINDOW_WIDTH;
-        uint8_t dy = chip8->V[chip8->instruction.y] % WINDOW_HEIGHT;
-        const uint8_t x = dx;
-
-        // Set V[0xF] to 0 in case of no collision
-        chip8->V[0xF] = 0;
-
-        for (uint8_t i = 0; i < chip8->instruction.n; i++) {
-          const uint8_t spriteByte = chip8->ram[chip8->indexRegister + i];
-          dx = x;
-
-          for (uint8_t j = 7; j > 0; j--) {
-            const uint8_t spriteBit = spriteByte & (1 << j);
-            uint8_t *frameBufferByte =
-                &chip8->frameBuffer[dy * WINDOW_WIDTH + dx];
-
-            // Collision detection
-            if (spriteBit && *frameBufferByte) {
-              chip8->V[0xF] = (spriteBit && *frameBufferByte);
-            }
-
-            *frameBufferByte ^= spriteBit;
-
-            if (++dx >= WINDOW_WIDTH) break;
-          }
-          if (++dy >= WINDOW_HEIGHT) break;
-        }
-        chip8->draw = true;
-      }
-      break;
-    case 0xE:
-      switch (chip8->instruction.kk) {
-        case 0x9E:
-          // 0xEX9E skip next instruction if the key stored in V[X] is pressed
-          if (chip8->keypad[chip8->V[chip8->instruction.x]]) {
-            chip8->programCounter += 2;
-          }
-          break;
-        case 0xA1:
-          // 0xEXA1 skip next instruction if the key stored in V[X] is not
-          // pressed
-          if (!chip8->keypad[chip8->V[chip8->instruction.x]]) {
-            chip8->programCounter += 2;
-          }
-          break;
-      }
-      break;
-    case 0xF:
-      switch (chip8->instruction.kk) {
-        case 0x07:
-          // 0xFX07 Set V[X] to the value of the delay timer
-          chip8->V[chip8->instruction.x] = chip8->delayTimer;
-          break;
-        case 0x0A: {
-          // 0xFX0A Wait for a key press, store the value of the key in V[X]
-          static uint8_t keyPressed = CHIP8_KEY_UP;
-          static uint16_t key = 0xFF;
-
-          for (uint32_t i = 0; i < KEYS && key == 0xFF; i++) {
-            if (chip8->keypad[i]) {
-              keyPressed = CHIP8_KEY_DOWN;
-              key = i;
-              break;
-            }
-          }
-
-          if (!keyPressed) {
-            chip8->programCounter -= 2;
-          } else {
-            if (!chip8->keypad[key]) {
-              chip8->programCounter -= 2;
-            } else {
-              chip8->V[chip8->instruction.x] = key;
-              keyPressed = CHIP8_KEY_UP;
-              key = 0xFF;
-            }
-          }
-        } break;
-        case 0x15:
-          // 0xFX15 set the delay timer to V[X]
-          chip8->delayTimer = chip8->V[chip8->instruction.x];
-          break;
-        case 0x18:
-          // 0xFX18 set the sound timer to V[X]
-          chip8->soundTimer = chip8->V[chip8->instruction.x];
-          break;
-        case 0x1E:
-          // 0xFX1E add V[X] to indexRegister and store the result in
-          // indexRegister
-          chip8->indexRegister += chip8->V[chip8->instruction.x];
-          break;
-        case 0x29:
-          // 0xFX29 set the indexRegister to the hexadecimal font
-          // pointed to by the V[X]
-          chip8->indexRegister = chip8->V[chip8->instruction.x] * 5;
-          break;
-        case 0x33: {
-          // 0xFX33 store the binary-coded decimal representation of V[X]
-          uint8_t bcd = chip8->V[chip8->instruction.x];
-          chip8->ram[chip8->indexRegister + 2] = bcd % 10;
-          bcd /= 10;
-          chip8->ram[chip8->indexRegister + 1] = bcd % 10;
-          bcd /= 10;
-          chip8->ram[chip8->indexRegister] = bcd;
-          break;
-        }
-        case 0x55:
-          // 0xFX55 Store V[0] to V[X] in memory starting at indexRegister
-          for (uint8_t i = 0; i <= chip8->instruction.x; i++) {
-            chip8->ram[chip8->indexRegister + i] = chip8->V[i];
-          }
-          break;
-        case 0x65:
-          // 0xFX65 Store memory starting at indexRegister to V[0] to V[X]
-          for (uint8_t i = 0; i <= chip8->instruction.x; i++) {
-            chip8->V[i] = chip8->ram[chip8->indexRegister + i];
-          }
-          break;
-      }
-      break;
-    default:
-      fprintf(stderr, "Unknown instruction: %04X\n", chip8->instruction.raw);
-      break;
-  }
-}
+void handleInput(Chip8 *chip8, const Config *config, Movie *movie) {
+  // Save states are kept next to the rom
+  char statePath[FILENAME_MAX];
+  snprintf(statePath, sizeof(statePath), "%s.state", config->romName);
 
-void handleInput(Chip8 *chip8) {
   SDL_Event event;
   // Fetch the next event
   SDL_PollEvent(&event);
@@ -571,9 +232,45 @@ void handleInput(Chip8 *chip8) {
     case SDL_KEYDOWN:
       switch (event.key.keysym.sym) {
         case SDLK_SPACE:
-          // Pause or unpause the emulator
+          // Pause or unpause the emulator, continuing past a breakpoint
+          if (stopReason(chip8) != STOP_NONE) resumeExecution(chip8);
           chip8->state = chip8->state == PAUSED ? RUNNING : PAUSED;
           break;
+        case SDLK_F10:
+          // Execute a single instruction while stopped by the debugger
+          if (stopReason(chip8) != STOP_NONE) {
+            stepExecution(chip8);
+            chip8->state = RUNNING;
+          }
+          break;
+        case SDLK_F5:
+          // Save the emulator state
+          saveStateFile(chip8, statePath);
+          break;
+        case SDLK_BACKSPACE:
+          // Rewind while held
+          if (chip8->state == RUNNING) chip8->state = REWINDING;
+          break;
+        case SDLK_F12:
+          // Flush the instruction trace on demand
+          if (chip8->trace != NULL) {
+            flushTrace(chip8->trace, config->tracePath);
+          }
+          break;
+        case SDLK_F9: {
+          // Restore the emulator state and redraw the restored frame
+          // buffer. The recording ends at the state before the load
+          const Chip8 before = *chip8;
+          if (loadStateFile(chip8, statePath)) {
+            chip8->draw = true;
+            if (movie != NULL && !movie->ended) {
+              endMovie(movie, &before);
+              fprintf(stderr, "Recording ended, loaded states are not "
+                              "recorded\n");
+            }
+          }
+          break;
+        }
         case SDLK_1:
           chip8->keypad[0x1] = CHIP8_KEY_DOWN;
           break;
@@ -626,6 +323,10 @@ void handleInput(Chip8 *chip8) {
       break;
     case SDL_KEYUP:
       switch (event.key.keysym.sym) {
+        case SDLK_BACKSPACE:
+          // Resume once released
+          if (chip8->state == REWINDING) chip8->state = RUNNING;
+          break;
         case SDLK_1:
           chip8->keypad[0x1] = CHIP8_KEY_UP;
           break;
@@ -679,22 +380,6 @@ void handleInput(Chip8 *chip8) {
   }
 }
 
-void nextInstruction(Chip8 *chip8) {
-  // Fetch raw opcode
-  chip8->instruction.raw = (chip8->ram[chip8->programCounter] << 8) |
-                           chip8->ram[chip8->programCounter + 1];
-
-  // Point the program counter to the next instruction
-  chip8->programCounter += 2;
-
-  // Descontruct the opcode
-  chip8->instruction.nnn = chip8->instruction.raw & 0x0FFF;       //*nnn
-  chip8->instruction.n = chip8->instruction.raw & 0x000F;         //***n
-  chip8->instruction.x = (chip8->instruction.raw >> 8) & 0x000F;  //*x**
-  chip8->instruction.y = (chip8->instruction.raw >> 4) & 0x000F;  //**y*
-  chip8->instruction.kk = chip8->instruction.raw & 0x00FF;        //**kk
-}
-
 void cleanup(const Sdl *sdl) {
   SDL_CloseAudioDevice(sdl->audioDevice);
   SDL_DestroyRenderer(sdl->renderer);
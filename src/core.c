@@ -0,0 +1,668 @@
+#include "core.h"
+
+#include "debugger.h"
+#include "profiler.h"
+#include "trace.h"
+// std
+#include <stdio.h>
+#include <string.h>
+
+void defaultConfig(Config *config) {
+  config->scaleFactor = 20;              // Scale the window by 20
+  config->foregroundColor = 0xD169B6FF;  // Pink
+  config->backgroundColor = 0x38374CFF;  // Dark blue
+  config->sampleFrequency = 44100;       // Standard CD quality
+  config->sampleSize = 2048;             // Buffer size in samples
+  config->audioFrequency = 440;          // A4 frequency
+  config->audioAmplitude = 5000;         // Volume
+  config->instructionsPerSecond = 700;   // Emulation speed
+  config->outlines = true;               // Draw outlines
+  config->profile = PROFILE_MODERN;      // Common interpreter behaviour
+  config->rewindBufferSize = 16 << 20;   // Rewind buffer of 16MiB
+  config->rewindFrames = 216000;         // An hour of frames at 60Hz
+}
+
+void updateTimers(Chip8 *chip8) {
+  if (chip8->delayTimer) chip8->delayTimer--;
+  if (chip8->soundTimer) chip8->soundTimer--;
+}
+
+bool initChip8(Chip8 *chip8, const Config *config) {
+  resetChip8(chip8);
+
+  // Select the interpreter for the configured quirk profile
+  setProfile(chip8, config->profile);
+
+  chip8->state = RUNNING;
+
+  return true;
+}
+
+void resetChip8(Chip8 *chip8) {
+  // Power cycle the machine, only the quirk profile survives
+  const Profile profile = chip8->profile;
+  memset(chip8, 0, CHIP8_STATE_SIZE);
+  chip8->profile = profile;
+
+  // Initialize the stack pointer to the top of the stack
+  chip8->stackPointer = 0;
+
+  // Not waiting on FX0A
+  chip8->waitKey = NO_KEY;
+
+  // Deterministic until seeded
+  seedRandom(chip8, 0);
+
+  chip8->fault = (Fault){0};
+  chip8->faultCount = 0;
+
+  // Load the font into memory
+  loadFont(chip8);
+
+  chip8->dirtyPages = ALL_DIRTY_PAGES;
+}
+
+void loadFont(Chip8 *chip8) {
+  const uint8_t font[FONT_SIZE] = {
+      0xF0, 0x90, 0x90, 0x90, 0xF0,  // 0
+      0x20, 0x60, 0x20, 0x20, 0x70,  // 1
+      0xF0, 0x10, 0xF0, 0x80, 0xF0,  // 2
+      0xF0, 0x10, 0xF0, 0x10, 0xF0,  // 3
+      0x90, 0x90, 0xF0, 0x10, 0x10,  // 4
+      0xF0, 0x80, 0xF0, 0x10, 0xF0,  // 5
+      0xF0, 0x80, 0xF0, 0x90, 0xF0,  // 6
+      0xF0, 0x10, 0x20, 0x40, 0x40,  // 7
+      0xF0, 0x90, 0xF0, 0x90, 0xF0,  // 8
+      0xF0, 0x90, 0xF0, 0x10, 0xF0,  // 9
+      0xF0, 0x80, 0x80, 0x80, 0xF0,  // C
+      0xE0, 0x90, 0x90, 0x90, 0xE0,  // D
+      0xF0, 0x80, 0xF0, 0x80, 0xF0,  // E
+      0xF0, 0x80, 0xF0, 0x80, 0x80   // F
+  };
+
+  memcpy(&chip8->ram, &font, FONT_SIZE);
+}
+
+bool loadRom(Chip8 *chip8, const char *filePath) {
+  FILE *rom = fopen(filePath, "rb");
+
+  if (rom == NULL) {
+    fprintf(stderr, "Failed to open ROM file: %s\n", filePath);
+    return false;
+  }
+
+  // Get the size of the ROM
+  fseek(rom, 0, SEEK_END);
+  const size_t romSize = ftell(rom);
+  rewind(rom);
+
+  // The ROM has to fit between the entry point and the end of memory
+  if (romSize > RAM_SIZE - PROGRAM_START) {
+    fprintf(stderr, "ROM file too large: %s\n", filePath);
+    fclose(rom);
+    return false;
+  }
+
+  // Read the ROM into memory, Chip8 programs start at 0x200
+  uint8_t data[RAM_SIZE - PROGRAM_START];
+  fread(data, romSize, 1, rom);
+
+  fclose(rom);
+
+  return loadRomData(chip8, data, romSize);
+}
+
+bool loadRomData(Chip8 *chip8, const uint8_t *data, const size_t size) {
+  if (size > RAM_SIZE - PROGRAM_START) {
+    return false;
+  }
+
+  memcpy(&chip8->ram[PROGRAM_START], data, size);
+  chip8->romSize = size;
+  chip8->dirtyPages = ALL_DIRTY_PAGES;
+
+  // Point the program counter to the start of the ROM
+  chip8->programCounter = PROGRAM_START;
+
+  return true;
+}
+
+// Advances the xorshift random number generator and returns the next byte
+static inline uint8_t nextRandom(Chip8 *chip8) {
+  uint32_t x = chip8->randomState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  chip8->randomState = x;
+
+  return x >> 24;
+}
+
+// Write barrier of the stores, marks the page of ram holding the address
+static inline void markRam(Chip8 *chip8, const uint16_t address) {
+  chip8->dirtyPages |= 1u << (address & (RAM_SIZE - 1)) / DIRTY_PAGE_SIZE;
+}
+
+// Records a fault of the instruction fetched from the address. Out of line
+// and cold, so the checks leading here cost the interpreters a branch each
+static __attribute__((noinline, cold)) void raiseFault(Chip8 *chip8,
+                                                       const FaultKind kind,
+                                                       const uint16_t address) {
+  chip8->fault = (Fault){
+      .kind = kind,
+      .address = address & (RAM_SIZE - 1),
+      .opcode = chip8->instruction.raw,
+      .cycle = chip8->cycles,
+  };
+  chip8->faultCount++;
+}
+
+// Decodes and executes the instruction. Always inlined into the profile
+// interpreters below so every quirk check folds away at compile time, as
+// do the breakpoint and watchpoint checks outside the debug interpreters.
+static inline __attribute__((always_inline)) void executeInstruction(
+    Chip8 *chip8, const Quirks quirks, const bool debug) {
+  const uint16_t address = chip8->programCounter;
+
+  // Stop before the instruction on a breakpoint
+  if (debug && !checkBreakpoint(chip8->debugger, address)) return;
+
+  // Fetch the next instruction
+  nextInstruction(chip8);
+  chip8->cycles++;
+  PROFILE_INSTRUCTION(chip8);
+
+  // Instruction decoding
+  switch (chip8->instruction.raw >> 12) {
+    case 0x0:
+      // 0x00E0 clear the screen
+      if (chip8->instruction.kk == 0xE0) {
+        memset(chip8->frameBuffer, 0, sizeof(chip8->frameBuffer));
+        chip8->dirtyPages |= ((1u << FRAME_PAGES) - 1) << RAM_PAGES;
+        chip8->draw = true;
+      }
+      // 0x00EE return from subroutine by subtracting one from the stackPointer
+      // and then setting the programCounter to the address on top of stock.
+      // The stack wraps around instead of underflowing
+      else if (chip8->instruction.kk == 0xEE) {
+        if (chip8->stackDepth == 0) {
+          raiseFault(chip8, FAULT_STACK_UNDERFLOW, address);
+        } else {
+          chip8->stackDepth--;
+        }
+        chip8->stackPointer = (chip8->stackPointer - 1) & (STACK_SIZE - 1);
+        chip8->programCounter = chip8->stack[chip8->stackPointer];
+        if (debug) enterBlock(chip8->debugger, chip8->programCounter);
+      }
+      // 0x0NNN machine code routines of the host cpu are unknown
+      else {
+        raiseFault(chip8, FAULT_OPCODE, address);
+      }
+      break;
+    case 0x1:
+      // 0x1NNN jump to instruction nnn
+      chip8->programCounter = chip8->instruction.nnn;
+      if (debug) enterBlock(chip8->debugger, chip8->programCounter);
+      break;
+    case 0x2:
+      // 0x2NNN call subroutine at address nnn, store the current
+      // address of the programCounter on top of stack and point
+      // the programCounter to nnn. The stack wraps around instead of
+      // overflowing
+      if (chip8->stackDepth == STACK_SIZE) {
+        raiseFault(chip8, FAULT_STACK_OVERFLOW, address);
+      } else {
+        chip8->stackDepth++;
+      }
+      chip8->stack[chip8->stackPointer] = chip8->programCounter;
+      chip8->stackPointer = (chip8->stackPointer + 1) & (STACK_SIZE - 1);
+      chip8->programCounter = chip8->instruction.nnn;
+      if (debug) enterBlock(chip8->debugger, chip8->programCounter);
+      break;
+    case 0x3:
+      // 0x3XKK skip next instruction if V[X] == KK
+      if (chip8->V[chip8->instruction.x] == chip8->instruction.kk) {
+        chip8->programCounter += 2;
+      }
+      break;
+    case 0x4:
+      // 0x4XKK skip next instruction if V[X] != KK
+      if (chip8->V[chip8->instruction.x] != chip8->instruction.kk) {
+        chip8->programCounter += 2;
+      }
+      break;
+    case 0x5:
+      // 05XY0 skip next instruction if V[X] == V[Y], any N executes as 0
+      if (chip8->instruction.n) raiseFault(chip8, FAULT_OPCODE, address);
+      if (chip8->V[chip8->instruction.x] == chip8->V[chip8->instruction.y]) {
+        chip8->programCounter += 2;
+      }
+      break;
+    case 0x6:
+      // 0x6XKK store the KK in the register V[X]
+      chip8->V[chip8->instruction.x] = chip8->instruction.kk;
+      break;
+    case 0x7:
+      // 0x7XKK add KK and V[X] and store the result in V[X] register
+      chip8->V[chip8->instruction.x] += chip8->instruction.kk;
+      break;
+    case 0x8:
+      switch (chip8->instruction.n) {
+        case 0x0:
+          // 0x8XY0  store the value of V[Y] in V[X]
+          chip8->V[chip8->instruction.x] = chip8->V[chip8->instruction.y];
+          break;
+        case 0x1:
+          // 0x8XY1 perform bitwise or operator on V[X] and V[Y] and
+          // store the result in V[X]
+          chip8->V[chip8->instruction.x] |= chip8->V[chip8->instruction.y];
+          if (quirks.vfReset) chip8->V[0xF] = 0;
+          break;
+        case 0x2:
+          // 0x8XY2 perform bitwise and operator on V[X] and V[Y] and
+          // store the result in V[X]
+          chip8->V[chip8->instruction.x] &= chip8->V[chip8->instruction.y];
+          if (quirks.vfReset) chip8->V[0xF] = 0;
+          break;
+        case 0x3:
+          // 0x8XY3 perform bitwise or operator on V[X] and V[Y] xor
+          // store the result in V[X]
+          chip8->V[chip8->instruction.x] ^= chip8->V[chip8->instruction.y];
+          if (quirks.vfReset) chip8->V[0xF] = 0;
+          break;
+        case 0x4: {
+          // 0x8XY4 add V[X] and V[Y], if the result is greater than 0xFF
+          // then store 1 in V[0xF] otherwise store the lower 8 bits in
+          // the V[X]
+          uint8_t carry = (chip8->V[chip8->instruction.x] +
+                           chip8->V[chip8->instruction.y]) > 0xFF;
+
+          chip8->V[chip8->instruction.x] += chip8->V[chip8->instruction.y];
+          chip8->V[0xF] = carry;
+        } break;
+        case 0x5:
+          // 0x8XY5 store 1 in V[X] if greater than V[Y] otherwise 0
+          chip8->V[0xF] =
+              chip8->V[chip8->instruction.x] > chip8->V[chip8->instruction.y];
+          chip8->V[chip8->instruction.x] -= chip8->V[chip8->instruction.y];
+          break;
+        case 0x6: {
+          // 0x8XY6 store 1 in V[F] if the least significant bit in V[Y]
+          // is 1 otherwise 0. Then store V[Y] divided by 2 in V[X]. With
+          // the shift quirk V[X] is shifted in place
+          const uint8_t source = quirks.shift ? chip8->V[chip8->instruction.x]
+                                              : chip8->V[chip8->instruction.y];
+          chip8->V[chip8->instruction.x] = source >> 1;
+          chip8->V[0xF] = source & 1;
+        } break;
+        case 0x7:
+          // 0x8XY7 store 1 in V[F] if V[X] > V[Y] otherwise 0. Then
+          // subtracting V[Y] from V[X] and store the result in V[X]
+          chip8->V[0xF] =
+              chip8->V[chip8->instruction.y] > chip8->V[chip8->instruction.x];
+          chip8->V[chip8->instruction.x] =
+              chip8->V[chip8->instruction.y] - chip8->V[chip8->instruction.x];
+          break;
+        case 0xE: {
+          // 0x8XYE store 1 in V[F] if the most significant bit in V[Y]
+          // is 1 otherwise 0. Then store V[Y] multiplied by 2 in V[X]. With
+          // the shift quirk V[X] is shifted in place
+          const uint8_t source = quirks.shift ? chip8->V[chip8->instruction.x]
+                                              : chip8->V[chip8->instruction.y];
+          chip8->V[chip8->instruction.x] = source << 1;
+          chip8->V[0xF] = (source >> 7) & 1;
+        } break;
+        default:
+          raiseFault(chip8, FAULT_OPCODE, address);
+          break;
+      }
+      break;
+    case 0x9:
+      // 0x9XY0 if V[X] != V[Y] skip next instruction, any N executes as 0
+      if (chip8->instruction.n) raiseFault(chip8, FAULT_OPCODE, address);
+      if (chip8->V[chip8->instruction.x] != chip8->V[chip8->instruction.y]) {
+        chip8->programCounter += 2;
+      }
+      break;
+    case 0xA:
+      // 0xANNN set the indexRegister to NNN
+      chip8->indexRegister = chip8->instruction.nnn;
+      break;
+    case 0xB:
+      // 0xBNNN jump to instruction at NNN + V[0x0]. With the jump quirk
+      // this is 0xBXNN and jumps to XNN + V[X]
+      chip8->programCounter =
+          chip8->instruction.nnn +
+          chip8->V[quirks.jump ? chip8->instruction.x : 0x0];
+      if (debug) enterBlock(chip8->debugger, chip8->programCounter);
+      break;
+    case 0xC:
+      // 0xCXKK generate a random number between 0 and 255, & it with KK
+      // and store the result in V[X]
+      chip8->V[chip8->instruction.x] =
+          nextRandom(chip8) & chip8->instruction.kk;
+      break;
+    case 0xD:
+      // 0xDXYN draw a n byte sprite at V[X], V[Y] coordinates
+      // Set V[0xF] to collision detection. Sprites wrap around the
+      // screen edges unless the clipping quirk is set
+      {
+        const uint8_t x = chip8->V[chip8->instruction.x] % WINDOW_WIDTH;
+        const uint8_t y = chip8->V[chip8->instruction.y] % WINDOW_HEIGHT;
+
+        // Set V[0xF] to 0 in case of no collision
+        chip8->V[0xF] = 0;
+
+        if (chip8->indexRegister + chip8->instruction.n > RAM_SIZE) {
+          raiseFault(chip8, FAULT_RAM, address);
+        }
+
+        for (uint8_t i = 0; i < chip8->instruction.n; i++) {
+          const uint8_t spriteByte =
+              chip8->ram[(chip8->indexRegister + i) & (RAM_SIZE - 1)];
+          uint8_t dy = y + i;
+
+          if (dy >= WINDOW_HEIGHT) {
+            if (quirks.clipping) break;
+            dy %= WINDOW_HEIGHT;
+          }
+          chip8->dirtyPages |=
+              1u << (RAM_PAGES + dy * WINDOW_WIDTH / DIRTY_PAGE_SIZE);
+
+          for (uint8_t j = 0; j < 8; j++) {
+            const uint8_t spriteBit = (spriteByte >> (7 - j)) & 1;
+            uint8_t dx = x + j;
+
+            if (dx >= WINDOW_WIDTH) {
+              if (quirks.clipping) break;
+              dx %= WINDOW_WIDTH;
+            }
+
+            uint8_t *frameBufferByte =
+                &chip8->frameBuffer[dy * WINDOW_WIDTH + dx];
+
+            // Collision detection
+            if (spriteBit && *frameBufferByte) {
+              chip8->V[0xF] = 1;
+            }
+
+            *frameBufferByte ^= spriteBit;
+          }
+        }
+        chip8->draw = true;
+      }
+      break;
+    case 0xE:
+      if (chip8->V[chip8->instruction.x] >= KEYS &&
+          (chip8->instruction.kk == 0x9E || chip8->instruction.kk == 0xA1)) {
+        raiseFault(chip8, FAULT_KEY, address);
+      }
+      switch (chip8->instruction.kk) {
+        case 0x9E:
+          // 0xEX9E skip next instruction if the key stored in V[X] is pressed,
+          // only the low nibble of V[X] selects the key
+          if (chip8->keypad[chip8->V[chip8->instruction.x] & (KEYS - 1)]) {
+            chip8->programCounter += 2;
+          }
+          break;
+        case 0xA1:
+          // 0xEXA1 skip next instruction if the key stored in V[X] is not
+          // pressed
+          if (!chip8->keypad[chip8->V[chip8->instruction.x] & (KEYS - 1)]) {
+            chip8->programCounter += 2;
+          }
+          break;
+        default:
+          raiseFault(chip8, FAULT_OPCODE, address);
+          break;
+      }
+      break;
+    case 0xF:
+      switch (chip8->instruction.kk) {
+        case 0x07:
+          // 0xFX07 Set V[X] to the value of the delay timer
+          chip8->V[chip8->instruction.x] = chip8->delayTimer;
+          break;
+        case 0x0A:
+          // 0xFX0A Wait for a key press and release, store the value of the
+          // key in V[X]. The pressed key is kept in waitKey until released
+          if (chip8->waitKey == NO_KEY) {
+            for (uint8_t i = 0; i < KEYS; i++) {
+              if (chip8->keypad[i]) {
+                chip8->waitKey = i;
+                break;
+              }
+            }
+          }
+
+          if (chip8->waitKey == NO_KEY || chip8->keypad[chip8->waitKey]) {
+            chip8->programCounter -= 2;
+          } else {
+            chip8->V[chip8->instruction.x] = chip8->waitKey;
+            chip8->waitKey = NO_KEY;
+          }
+          break;
+        case 0x15:
+          // 0xFX15 set the delay timer to V[X]
+          chip8->delayTimer = chip8->V[chip8->instruction.x];
+          break;
+        case 0x18:
+          // 0xFX18 set the sound timer to V[X]
+          chip8->soundTimer = chip8->V[chip8->instruction.x];
+          break;
+        case 0x1E:
+          // 0xFX1E add V[X] to indexRegister and store the result in
+          // indexRegister
+          chip8->indexRegister += chip8->V[chip8->instruction.x];
+          break;
+        case 0x29:
+          // 0xFX29 set the indexRegister to the hexadecimal font
+          // pointed to by the V[X]
+          chip8->indexRegister = chip8->V[chip8->instruction.x] * 5;
+          break;
+        case 0x33: {
+          // 0xFX33 store the binary-coded decimal representation of V[X].
+          // Memory accesses through indexRegister wrap around the end of ram
+          if (debug) checkWatchpoints(chip8->debugger, chip8->indexRegister, 3);
+          const uint16_t index = chip8->indexRegister;
+          if (index + 3 > RAM_SIZE) raiseFault(chip8, FAULT_RAM, address);
+          uint8_t bcd = chip8->V[chip8->instruction.x];
+          chip8->ram[(index + 2) & (RAM_SIZE - 1)] = bcd % 10;
+          bcd /= 10;
+          chip8->ram[(index + 1) & (RAM_SIZE - 1)] = bcd % 10;
+          bcd /= 10;
+          chip8->ram[index & (RAM_SIZE - 1)] = bcd;
+          markRam(chip8, index);
+          markRam(chip8, index + 2);
+          break;
+        }
+        case 0x55:
+          // 0xFX55 Store V[0] to V[X] in memory starting at indexRegister
+          if (debug) {
+            checkWatchpoints(chip8->debugger, chip8->indexRegister,
+                             chip8->instruction.x + 1);
+          }
+          if (chip8->indexRegister + chip8->instruction.x >= RAM_SIZE) {
+            raiseFault(chip8, FAULT_RAM, address);
+          }
+          for (uint8_t i = 0; i <= chip8->instruction.x; i++) {
+            chip8->ram[(chip8->indexRegister + i) & (RAM_SIZE - 1)] =
+                chip8->V[i];
+          }
+          markRam(chip8, chip8->indexRegister);
+          markRam(chip8, chip8->indexRegister + chip8->instruction.x);
+          if (quirks.memory) {
+            chip8->indexRegister += chip8->instruction.x +
+                                    !quirks.memoryIncrementByX;
+          }
+          break;
+        case 0x65:
+          // 0xFX65 Store memory starting at indexRegister to V[0] to V[X]
+          if (chip8->indexRegister + chip8->instruction.x >= RAM_SIZE) {
+            raiseFault(chip8, FAULT_RAM, address);
+          }
+          for (uint8_t i = 0; i <= chip8->instruction.x; i++) {
+            chip8->V[i] =
+                chip8->ram[(chip8->indexRegister + i) & (RAM_SIZE - 1)];
+          }
+          if (quirks.memory) {
+            chip8->indexRegister += chip8->instruction.x +
+                                    !quirks.memoryIncrementByX;
+          }
+          break;
+        default:
+          raiseFault(chip8, FAULT_OPCODE, address);
+          break;
+      }
+      break;
+  }
+
+  TRACE_INSTRUCTION(chip8, address);
+
+  // Stop again after a single step
+  if (debug && chip8->debugger->stepping) {
+    chip8->debugger->stepping = false;
+    stopExecution(chip8->debugger, STOP_STEP, chip8->programCounter);
+  }
+}
+
+// Quirks of each profile, constant so the interpreters below fold them
+static const Quirks profileQuirks[PROFILE_COUNT] = {
+    [PROFILE_VIP] = {.memory = true, .vfReset = true, .clipping = true},
+    [PROFILE_CHIP48] = {.shift = true,
+                        .memory = true,
+                        .memoryIncrementByX = true,
+                        .clipping = true,
+                        .jump = true},
+    [PROFILE_SCHIP] = {.shift = true, .clipping = true, .jump = true},
+    [PROFILE_XOCHIP] = {.memory = true},
+    [PROFILE_MODERN] = {.shift = true, .clipping = true},
+};
+
+// Generates an interpreter with the quirks fixed at compile time, along
+// with its debug variant checking breakpoints and watchpoints
+#define INTERPRETER(name, profile)                            \
+  static void name(Chip8 *chip8) {                            \
+    executeInstruction(chip8, profileQuirks[profile], false); \
+  }                                                           \
+  static void name##Debug(Chip8 *chip8) {                     \
+    executeInstruction(chip8, profileQuirks[profile], true);  \
+  }
+
+INTERPRETER(interpretVip, PROFILE_VIP)
+INTERPRETER(interpretChip48, PROFILE_CHIP48)
+INTERPRETER(interpretSchip, PROFILE_SCHIP)
+INTERPRETER(interpretXochip, PROFILE_XOCHIP)
+INTERPRETER(interpretModern, PROFILE_MODERN)
+
+void emulateReference(Chip8 *chip8) {
+  // Not specialised, every quirk is checked as the instruction executes
+  executeInstruction(chip8, profileQuirks[chip8->profile], false);
+}
+
+void setProfile(Chip8 *chip8, const Profile profile) {
+  static const Interpreter interpreters[PROFILE_COUNT] = {
+      [PROFILE_VIP] = interpretVip,
+      [PROFILE_CHIP48] = interpretChip48,
+      [PROFILE_SCHIP] = interpretSchip,
+      [PROFILE_XOCHIP] = interpretXochip,
+      [PROFILE_MODERN] = interpretModern,
+  };
+  static const Interpreter debugInterpreters[PROFILE_COUNT] = {
+      [PROFILE_VIP] = interpretVipDebug,
+      [PROFILE_CHIP48] = interpretChip48Debug,
+      [PROFILE_SCHIP] = interpretSchipDebug,
+      [PROFILE_XOCHIP] = interpretXochipDebug,
+      [PROFILE_MODERN] = interpretModernDebug,
+  };
+
+  chip8->profile = profile;
+  chip8->interpreter = debuggerActive(chip8) ? debugInterpreters[profile]
+                                             : interpreters[profile];
+}
+
+void seedRandom(Chip8 *chip8, const uint32_t seed) {
+  // Mix the seed so nearby seeds diverge, xorshift must not start at 0
+  uint32_t x = seed * 0x9E3779B9u;
+  x ^= x >> 16;
+  chip8->randomState = x ? x : 0x6D2B79F5u;
+}
+
+Quirks quirksOf(const Profile profile) { return profileQuirks[profile]; }
+
+bool parseProfile(const char *name, Profile *profile) {
+  static const char *names[PROFILE_COUNT] = {
+      [PROFILE_VIP] = "vip",
+      [PROFILE_CHIP48] = "chip48",
+      [PROFILE_SCHIP] = "schip",
+      [PROFILE_XOCHIP] = "xochip",
+      [PROFILE_MODERN] = "modern",
+  };
+
+  for (uint32_t i = 0; i < PROFILE_COUNT; i++) {
+    if (strcmp(name, names[i]) == 0) {
+      *profile = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void emulateInstruction(Chip8 *chip8, const Config *config) {
+  // Dispatch to the interpreter selected when the rom was loaded
+  chip8->interpreter(chip8);
+}
+
+FaultKind runFrame(Chip8 *chip8, const uint32_t instructions) {
+  // Call the interpreter directly instead of through emulateInstruction
+  const Interpreter interpreter = chip8->interpreter;
+  const uint32_t faultCount = chip8->faultCount;
+  const uint64_t cycles = chip8->cycles;
+
+  for (uint32_t i = 0; i < instructions; i++) {
+    interpreter(chip8);
+  }
+
+  // The timers tick when the cycles reach the end of a frame, so a frame
+  // the debugger stopped short ticks them once the rest of it has run
+  if (instructions == 0 ||
+      chip8->cycles / instructions != cycles / instructions) {
+    updateTimers(chip8);
+  }
+
+  return chip8->faultCount != faultCount ? chip8->fault.kind : FAULT_NONE;
+}
+
+uint16_t keypadState(const Chip8 *chip8) {
+  uint16_t keys = 0;
+
+  for (uint32_t i = 0; i < KEYS; i++) {
+    keys |= (chip8->keypad[i] == CHIP8_KEY_DOWN) << i;
+  }
+
+  return keys;
+}
+
+void setKeypadState(Chip8 *chip8, const uint16_t keys) {
+  for (uint32_t i = 0; i < KEYS; i++) {
+    chip8->keypad[i] = (keys >> i) & 1 ? CHIP8_KEY_DOWN : CHIP8_KEY_UP;
+  }
+}
+
+void nextInstruction(Chip8 *chip8) {
+  // Fetch raw opcode, jumps past the end of ram wrap around
+  const uint16_t address = chip8->programCounter & (RAM_SIZE - 1);
+  chip8->instruction.raw = (chip8->ram[address] << 8) |
+                           chip8->ram[(address + 1) & (RAM_SIZE - 1)];
+
+  // Point the program counter to the next instruction
+  chip8->programCounter = address + 2;
+
+  // Descontruct the opcode
+  chip8->instruction.nnn = chip8->instruction.raw & 0x0FFF;       //*nnn
+  chip8->instruction.n = chip8->instruction.raw & 0x000F;         //***n
+  chip8->instruction.x = (chip8->instruction.raw >> 8) & 0x000F;  //*x**
+  chip8->instruction.y = (chip8->instruction.raw >> 4) & 0x000F;  //**y*
+  chip8->instruction.kk = chip8->instruction.raw & 0x00FF;        //**kk
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+// std
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WINDOW_WIDTH 64
+#define WINDOW_HEIGHT 32
+#define FRAME_RATE 60
+
+#define NUM_REGISTERS 16
+#define RAM_SIZE 0x1000
+#define STACK_SIZE 0x40
+#define FONT_SIZE 0x200
+#define PROGRAM_START 0x200
+
+// Ram and the framebuffer are tracked in pages for copy-on-write snapshots
+#define DIRTY_PAGE_SIZE 0x100
+#define RAM_PAGES (RAM_SIZE / DIRTY_PAGE_SIZE)
+#define FRAME_PAGES (WINDOW_WIDTH * WINDOW_HEIGHT / DIRTY_PAGE_SIZE)
+#define ALL_DIRTY_PAGES ((1u << (RAM_PAGES + FRAME_PAGES)) - 1)
+
+#define CHIP8_KEY_DOWN 1
+#define CHIP8_KEY_UP 0
+#define KEYS 16
+#define NO_KEY 0xFF
+
+// Quirk profiles
+typedef enum {
+  PROFILE_VIP = 0,
+  PROFILE_CHIP48,
+  PROFILE_SCHIP,
+  PROFILE_XOCHIP,
+  PROFILE_MODERN,
+  PROFILE_COUNT
+} Profile;
+
+// Behaviour differences between chip8 platforms
+typedef struct {
+  bool shift;               // 8XY6/8XYE shift V[X] in place instead of V[Y]
+  bool memory;              // FX55/FX65 increment the indexRegister
+  bool memoryIncrementByX;  // FX55/FX65 increment by X instead of X + 1
+  bool vfReset;             // 8XY1/8XY2/8XY3 reset V[F] to 0
+  bool clipping;            // DXYN clips sprites instead of wrapping them
+  bool jump;                // BNNN jumps to NNN + V[X] instead of NNN + V[0]
+} Quirks;
+
+// Emulator configuration
+typedef struct {
+  uint32_t scaleFactor;
+  uint32_t foregroundColor;
+  uint32_t backgroundColor;
+  uint32_t sampleFrequency;
+  uint32_t sampleSize;
+  uint32_t audioFrequency;
+  uint32_t audioAmplitude;
+  uint32_t instructionsPerSecond;
+  char* romName;
+  char* tracePath;
+  bool outlines;
+  Profile profile;
+  uint32_t rewindBufferSize;
+  uint32_t rewindFrames;
+} Config;
+
+// Deconstructed instruction
+typedef struct {
+  uint16_t raw;
+  uint16_t nnn;
+  uint8_t n;
+  uint8_t x;
+  uint8_t y;
+  uint8_t kk;
+} Instruction;
+
+// Emulator state
+typedef enum { QUIT = 0, PAUSED, RUNNING, REWINDING } State;
+
+// Instructions a rom has no business executing. They execute as they always
+// have, the fault is only recorded
+typedef enum {
+  FAULT_NONE = 0,
+  FAULT_OPCODE,           // unknown instruction, skipped
+  FAULT_STACK_OVERFLOW,   // call with every stack entry in use
+  FAULT_STACK_UNDERFLOW,  // return with the stack empty
+  FAULT_RAM,              // access through the indexRegister past ram
+  FAULT_KEY,              // key past F in V[X], its low nibble is used
+  FAULT_COUNT
+} FaultKind;
+
+typedef struct {
+  FaultKind kind;
+  uint16_t address;
+  uint16_t opcode;
+  uint64_t cycle;
+} Fault;
+
+// Emulator specification
+typedef struct Chip8 Chip8;
+
+// Instruction trace ring, see trace.h
+typedef struct Trace Trace;
+
+// Breakpoints and watchpoints, see debugger.h
+typedef struct Debugger Debugger;
+
+// Interpreter specialised for a single quirk profile
+typedef void (*Interpreter)(Chip8* chip8);
+
+struct Chip8 {
+  // Machine state, position independent so it can be saved and
+  // restored as a single block
+  uint8_t frameBuffer[WINDOW_WIDTH * WINDOW_HEIGHT];
+  uint8_t V[NUM_REGISTERS];
+  uint16_t stack[STACK_SIZE];
+  uint8_t ram[RAM_SIZE];
+  uint8_t keypad[KEYS];
+  uint16_t indexRegister;
+  uint8_t stackPointer;
+  uint8_t stackDepth;  // Entries in use, the stack pointer wraps around
+  uint16_t programCounter;
+  uint8_t delayTimer;
+  uint8_t soundTimer;
+  uint8_t draw;
+  uint8_t waitKey;
+  uint16_t romSize;
+  uint32_t randomState;
+  uint64_t cycles;
+  Profile profile;
+  Instruction instruction;
+  // Host state, not part of a saved state
+  State state;
+  // Pages of ram and then of the framebuffer written since last cleared, by
+  // instructions or the debugger, or all of them when the state is replaced
+  uint32_t dirtyPages;
+  // Last fault and the number of faults since power on
+  Fault fault;
+  uint32_t faultCount;
+  Interpreter interpreter;
+  Trace* trace;
+  Debugger* debugger;
+};
+
+// Size of the machine state at the start of the emulator state
+#define CHIP8_STATE_SIZE offsetof(Chip8, state)
+
+/**
+ * Initializes the emulator configuration.
+ * @param config - the emulator configuration
+ */
+void defaultConfig(Config* config);
+
+/**
+ * Initializes the emulator state by loading the font and rom into memory
+ * and setting the program counter to the start of the rom.
+ * @param chip8 - the emulator state
+ * @param config - the emulator configuration
+ * @return true if initialization was successful, false otherwise
+ */
+bool initChip8(Chip8* chip8, const Config* config);
+
+/**
+ * Resets the machine state to power on with the font loaded, keeping the
+ * quirk profile and the host state. The rom has to be loaded again.
+ * @param chip8 - the emulator state
+ */
+void resetChip8(Chip8* chip8);
+
+/**
+ * Loads the font into memory.
+ * @param chip8 - the emulator state
+ */
+void loadFont(Chip8* chip8);
+
+/**
+ * Loads the rom into memory, records its size and sets the program
+ * counter to the start of the rom.
+ * @param chip8 - the emulator state
+ * @param filePath - the path to the rom
+ * @return true if loading was successful, false otherwise
+ */
+bool loadRom(Chip8* chip8, const char* filePath);
+
+/**
+ * Loads the rom from memory, records its size and sets the program
+ * counter to the start of the rom.
+ * @param chip8 - the emulator state
+ * @param data - the rom
+ * @param size - the size of the rom
+ * @return true if the rom fits into memory, false otherwise
+ */
+bool loadRomData(Chip8* chip8, const uint8_t* data, const size_t size);
+
+/**
+ * Selects the interpreter specialised for the given quirk profile, or
+ * its debug variant while breakpoints or watchpoints are set.
+ * Should be called once after the rom is loaded.
+ * @param chip8 - the emulator state
+ * @param profile - the quirk profile
+ */
+void setProfile(Chip8* chip8, const Profile profile);
+
+/**
+ * Seeds the random number generator used by CXKK.
+ * @param chip8 - the emulator state
+ * @param seed - the seed
+ */
+void seedRandom(Chip8* chip8, const uint32_t seed);
+
+/**
+ * Parses a quirk profile from its name(vip, chip48, schip, xochip or
+ * modern).
+ * @param name - the profile name
+ * @param profile - the parsed profile
+ * @return true if the name is a known profile, false otherwise
+ */
+bool parseProfile(const char* name, Profile* profile);
+
+/**
+ * Looks up the quirks of a profile, for engines executing outside the
+ * specialised interpreters.
+ * @param profile - the quirk profile
+ * @return the quirks the profile's interpreter runs with
+ */
+Quirks quirksOf(const Profile profile);
+
+/**
+ * Updates the timers by decrementing them if they are greater than 0
+ * at a rate of 60hz.
+ * @param chip8 - the emulator state
+ */
+void updateTimers(Chip8* chip8);
+
+/**
+ * Runs a frame by executing the given number of instructions and then
+ * updating the timers. The timers tick whenever the cycles reach the end of
+ * a frame, so single-stepping the debugger ticks them once every frame's
+ * worth of instructions. A fault does not cut the frame short, callers
+ * wanting to stop on one stop after the frame.
+ * @param chip8 - the emulator state
+ * @param instructions - the number of instructions per frame
+ * @return the kind of the last fault of the frame, FAULT_NONE if none
+ */
+FaultKind runFrame(Chip8* chip8, const uint32_t instructions);
+
+/**
+ * Packs the keypad into a bitmask with bit i set if key i is down.
+ * @param chip8 - the emulator state
+ * @return the keypad bitmask
+ */
+uint16_t keypadState(const Chip8* chip8);
+
+/**
+ * Sets the keypad from a bitmask with bit i set if key i is down.
+ * @param chip8 - the emulator state
+ * @param keys - the keypad bitmask
+ */
+void setKeypadState(Chip8* chip8, const uint16_t keys);
+
+/**
+ * Fetches the next instruction from memory.
+ * @param chip8 - the emulator state
+ */
+void nextInstruction(Chip8* chip8);
+
+/**
+ * Decodes and executes the instruction using the interpreter selected
+ * for the current quirk profile.
+ * @param chip8 - the emulator state
+ * @param config - the emulator configuration
+ */
+void emulateInstruction(Chip8* chip8, const Config* config);
+
+/**
+ * Executes an instruction with the quirks of the profile checked at run
+ * time instead of compiled in. Slower, it is the reference the specialised
+ * interpreters are checked against.
+ * @param chip8 - the emulator state
+ */
+void emulateReference(Chip8* chip8);
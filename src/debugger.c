@@ -0,0 +1,122 @@
+#include "debugger.h"
+// std
+#include <stdlib.h>
+
+uint16_t findBreakpoint(const Debugger *debugger, const uint16_t address) {
+  if (address >= RAM_SIZE) return NO_BREAKPOINT;
+
+  // Mask off the breakpoints before the address in its own word
+  uint32_t word = address / 64;
+  uint64_t bits = debugger->breakpoints[word] & (~0ull << (address % 64));
+
+  while (!bits) {
+    if (++word == RAM_SIZE / 64) return NO_BREAKPOINT;
+    bits = debugger->breakpoints[word];
+  }
+
+  return word * 64 + __builtin_ctzll(bits);
+}
+
+// Reselects the interpreter when the debugger starts or stops needing one
+static void updateInterpreter(Chip8 *chip8) {
+  setProfile(chip8, chip8->profile);
+  if (chip8->debugger != NULL) {
+    enterBlock(chip8->debugger, chip8->programCounter);
+  }
+}
+
+// Sets or clears the bit of the address, returning whether it changed
+static bool updateAddress(uint64_t *bitmap, const uint16_t address,
+                          const bool enabled) {
+  const uint64_t bit = 1ull << (address % 64);
+  uint64_t *word = &bitmap[(address % RAM_SIZE) / 64];
+  const bool changed = !(*word & bit) == enabled;
+
+  *word = enabled ? *word | bit : *word & ~bit;
+
+  return changed;
+}
+
+void attachDebugger(Chip8 *chip8, Debugger *debugger) {
+  chip8->debugger = debugger;
+  updateInterpreter(chip8);
+}
+
+void setBreakpoint(Chip8 *chip8, const uint16_t address, const bool enabled) {
+  Debugger *debugger = chip8->debugger;
+
+  if (updateAddress(debugger->breakpoints, address, enabled)) {
+    debugger->breakpointCount += enabled ? 1 : -1;
+  }
+
+  updateInterpreter(chip8);
+}
+
+void setWatchpoint(Chip8 *chip8, const uint16_t address, const bool enabled) {
+  Debugger *debugger = chip8->debugger;
+
+  if (updateAddress(debugger->watchpoints, address, enabled)) {
+    debugger->watchpointCount += enabled ? 1 : -1;
+  }
+
+  updateInterpreter(chip8);
+}
+
+void resumeExecution(Chip8 *chip8) {
+  Debugger *debugger = chip8->debugger;
+
+  // Step over a breakpoint at the current instruction
+  debugger->resuming = true;
+  debugger->stopReason = STOP_NONE;
+
+  updateInterpreter(chip8);
+}
+
+void stepExecution(Chip8 *chip8) {
+  chip8->debugger->stepping = true;
+  resumeExecution(chip8);
+}
+
+void interruptExecution(Chip8 *chip8) {
+  Debugger *debugger = chip8->debugger;
+
+  if (debugger->stopReason == STOP_NONE) {
+    stopExecution(debugger, STOP_INTERRUPT, chip8->programCounter);
+  }
+
+  updateInterpreter(chip8);
+}
+
+bool debuggerActive(const Chip8 *chip8) {
+  const Debugger *debugger = chip8->debugger;
+
+  return debugger != NULL &&
+         (debugger->breakpointCount || debugger->watchpointCount ||
+          debugger->stepping || debugger->stopReason != STOP_NONE);
+}
+
+StopReason stopReason(const Chip8 *chip8) {
+  return chip8->debugger != NULL ? chip8->debugger->stopReason : STOP_NONE;
+}
+
+bool parseAddress(const char *text, uint16_t *address) {
+  char *end;
+  const unsigned long value = strtoul(text, &end, 0);
+
+  if (*text == '\0' || *end != '\0' || value >= RAM_SIZE) return false;
+
+  *address = value;
+  return true;
+}
+
+const char *stopReasonName(const StopReason reason) {
+  static const char *names[] = {
+      [STOP_NONE] = "none",
+      [STOP_BREAKPOINT] = "breakpoint",
+      [STOP_WATCHPOINT] = "watchpoint",
+      [STOP_STEP] = "step",
+      [STOP_INTERRUPT] = "interrupt",
+  };
+
+  return names[reason];
+}
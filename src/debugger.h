@@ -0,0 +1,204 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+
+// No breakpoint ahead of the current basic block
+#define NO_BREAKPOINT 0xFFFF
+
+// Why the emulator stopped
+typedef enum {
+  STOP_NONE = 0,
+  STOP_BREAKPOINT,
+  STOP_WATCHPOINT,
+  STOP_STEP,
+  STOP_INTERRUPT
+} StopReason;
+
+// Breakpoints and watchpoints as one bit per address. While any are set
+// the emulator runs an interpreter instrumented for them, otherwise the
+// regular interpreter runs untouched
+struct Debugger {
+  uint64_t breakpoints[RAM_SIZE / 64];
+  uint64_t watchpoints[RAM_SIZE / 64];
+  uint32_t breakpointCount;
+  uint32_t watchpointCount;
+  uint16_t nextBreakpoint;
+  uint16_t stopAddress;
+  StopReason stopReason;
+  bool stepping;
+  bool resuming;
+};
+
+/**
+ * Checks if the address is set in the bitmap.
+ * @param bitmap - the breakpoint or watchpoint bitmap
+ * @param address - the address
+ * @return true if the address is set, false otherwise
+ */
+static inline bool testAddress(const uint64_t* bitmap, const uint16_t address) {
+  return (bitmap[(address % RAM_SIZE) / 64] >> (address % 64)) & 1;
+}
+
+/**
+ * Finds the lowest breakpoint at or after the address.
+ * @param debugger - the debugger
+ * @param address - the address to search from
+ * @return the breakpoint address, NO_BREAKPOINT if there is none
+ */
+uint16_t findBreakpoint(const Debugger* debugger, const uint16_t address);
+
+/**
+ * Stops the emulator, the interpreter does nothing until it is resumed.
+ * @param debugger - the debugger
+ * @param reason - the stop reason
+ * @param address - the breakpoint or watched address
+ */
+static inline void stopExecution(Debugger* debugger, const StopReason reason,
+                                 const uint16_t address) {
+  debugger->stopReason = reason;
+  debugger->stopAddress = address;
+}
+
+/**
+ * Checks for a breakpoint before the instruction at the address is
+ * executed. Straight-line code only compares against the next breakpoint,
+ * which is looked up when a basic block is entered or when the program
+ * counter runs past the end of ram and wraps around.
+ * @param debugger - the debugger
+ * @param programCounter - the program counter of the instruction
+ * @return true if the instruction may execute, false if stopped
+ */
+static inline bool checkBreakpoint(Debugger* debugger,
+                                   const uint16_t programCounter) {
+  if (debugger->stopReason != STOP_NONE) return false;
+
+  // The instruction is fetched from the wrapped address, below the next
+  // breakpoint looked up for the block that ran off the end
+  const uint16_t address = programCounter & (RAM_SIZE - 1);
+  if (address != programCounter) {
+    debugger->nextBreakpoint = findBreakpoint(debugger, address);
+  }
+
+  if (address >= debugger->nextBreakpoint) {
+    // Stepped past a breakpoint that is not on an instruction boundary
+    if (address != debugger->nextBreakpoint) {
+      debugger->nextBreakpoint = findBreakpoint(debugger, address);
+    }
+
+    if (address == debugger->nextBreakpoint) {
+      if (!debugger->resuming) {
+        stopExecution(debugger, STOP_BREAKPOINT, address);
+        return false;
+      }
+
+      // The instruction stopped at executes once when resuming
+      debugger->nextBreakpoint = findBreakpoint(debugger, address + 1);
+    }
+  }
+
+  debugger->resuming = false;
+  return true;
+}
+
+/**
+ * Looks up the next breakpoint of the basic block entered at the address.
+ * Called after every jump, call and return.
+ * @param debugger - the debugger
+ * @param address - the first address of the basic block
+ */
+static inline void enterBlock(Debugger* debugger, const uint16_t address) {
+  debugger->nextBreakpoint =
+      debugger->breakpointCount ? findBreakpoint(debugger, address)
+                                : NO_BREAKPOINT;
+}
+
+/**
+ * Checks a store to memory against the watchpoints.
+ * @param debugger - the debugger
+ * @param address - the first address written
+ * @param size - the number of bytes written
+ */
+static inline void checkWatchpoints(Debugger* debugger, const uint16_t address,
+                                    const uint32_t size) {
+  for (uint32_t i = 0; i < size && debugger->watchpointCount; i++) {
+    if (testAddress(debugger->watchpoints, address + i)) {
+      stopExecution(debugger, STOP_WATCHPOINT, (address + i) % RAM_SIZE);
+      return;
+    }
+  }
+}
+
+/**
+ * Attaches the debugger to the emulator, NULL detaches it.
+ * @param chip8 - the emulator state
+ * @param debugger - the debugger
+ */
+void attachDebugger(Chip8* chip8, Debugger* debugger);
+
+/**
+ * Sets or clears a breakpoint on an instruction address.
+ * @param chip8 - the emulator state
+ * @param address - the instruction address
+ * @param enabled - true to set the breakpoint, false to clear it
+ */
+void setBreakpoint(Chip8* chip8, const uint16_t address, const bool enabled);
+
+/**
+ * Sets or clears a watchpoint on a memory address, stopping after any
+ * instruction that stores to it.
+ * @param chip8 - the emulator state
+ * @param address - the memory address
+ * @param enabled - true to set the watchpoint, false to clear it
+ */
+void setWatchpoint(Chip8* chip8, const uint16_t address, const bool enabled);
+
+/**
+ * Resumes a stopped emulator until the next breakpoint or watchpoint.
+ * @param chip8 - the emulator state
+ */
+void resumeExecution(Chip8* chip8);
+
+/**
+ * Resumes a stopped emulator for a single instruction.
+ * @param chip8 - the emulator state
+ */
+void stepExecution(Chip8* chip8);
+
+/**
+ * Stops the emulator at the current instruction, keeping the reason if
+ * it is already stopped. Only called between instructions.
+ * @param chip8 - the emulator state
+ */
+void interruptExecution(Chip8* chip8);
+
+/**
+ * Checks whether the emulator needs the instrumented interpreter.
+ * @param chip8 - the emulator state
+ * @return true if any breakpoint, watchpoint, step or stop is pending
+ */
+bool debuggerActive(const Chip8* chip8);
+
+/**
+ * Checks whether an attached debugger stopped the emulator.
+ * @param chip8 - the emulator state
+ * @return the stop reason, STOP_NONE if running
+ */
+StopReason stopReason(const Chip8* chip8);
+
+/**
+ * Parses a memory address such as 0x2A4.
+ * @param text - the address in decimal, hex or octal
+ * @param address - the parsed address
+ * @return true if the address is within ram, false otherwise
+ */
+bool parseAddress(const char* text, uint16_t* address);
+
+/**
+ * Gets a printable name of the stop reason.
+ * @param reason - the stop reason
+ * @return the name of the stop reason
+ */
+const char* stopReasonName(const StopReason reason);
@@ -0,0 +1,236 @@
+#include "disasm.h"
+// std
+#include <stdio.h>
+
+OpcodeClass opcodeClass(const uint16_t opcode) {
+  const uint8_t n = opcode & 0x000F;
+  const uint8_t kk = opcode & 0x00FF;
+
+  switch (opcode >> 12) {
+    case 0x0:
+      if (kk == 0xE0) return OP_CLS;
+      if (kk == 0xEE) return OP_RET;
+      return OP_SYS;
+    case 0x1:
+      return OP_JP;
+    case 0x2:
+      return OP_CALL;
+    case 0x3:
+      return OP_SE_BYTE;
+    case 0x4:
+      return OP_SNE_BYTE;
+    case 0x5:
+      return OP_SE_REG;
+    case 0x6:
+      return OP_LD_BYTE;
+    case 0x7:
+      return OP_ADD_BYTE;
+    case 0x8: {
+      static const OpcodeClass alu[16] = {
+          OP_LD_REG,  OP_OR,      OP_AND,     OP_XOR,     OP_ADD_REG, OP_SUB,
+          OP_SHR,     OP_SUBN,    OP_UNKNOWN, OP_UNKNOWN, OP_UNKNOWN, OP_UNKNOWN,
+          OP_UNKNOWN, OP_UNKNOWN, OP_SHL,     OP_UNKNOWN,
+      };
+      return alu[n];
+    }
+    case 0x9:
+      return OP_SNE_REG;
+    case 0xA:
+      return OP_LD_I;
+    case 0xB:
+      return OP_JP_V0;
+    case 0xC:
+      return OP_RND;
+    case 0xD:
+      return OP_DRW;
+    case 0xE:
+      if (kk == 0x9E) return OP_SKP;
+      if (kk == 0xA1) return OP_SKNP;
+      return OP_UNKNOWN;
+    default:
+      switch (kk) {
+        case 0x07:
+          return OP_LD_VX_DT;
+        case 0x0A:
+          return OP_LD_KEY;
+        case 0x15:
+          return OP_LD_DT;
+        case 0x18:
+          return OP_LD_ST;
+        case 0x1E:
+          return OP_ADD_I;
+        case 0x29:
+          return OP_LD_FONT;
+        case 0x33:
+          return OP_LD_BCD;
+        case 0x55:
+          return OP_STORE;
+        case 0x65:
+          return OP_LOAD;
+        default:
+          return OP_UNKNOWN;
+      }
+  }
+}
+
+const char *opcodeClassName(const OpcodeClass opcodeClass) {
+  static const char *names[OP_COUNT] = {
+      [OP_CLS] = "CLS",
+      [OP_RET] = "RET",
+      [OP_SYS] = "SYS addr",
+      [OP_JP] = "JP addr",
+      [OP_CALL] = "CALL addr",
+      [OP_SE_BYTE] = "SE Vx, byte",
+      [OP_SNE_BYTE] = "SNE Vx, byte",
+      [OP_SE_REG] = "SE Vx, Vy",
+      [OP_LD_BYTE] = "LD Vx, byte",
+      [OP_ADD_BYTE] = "ADD Vx, byte",
+      [OP_LD_REG] = "LD Vx, Vy",
+      [OP_OR] = "OR Vx, Vy",
+      [OP_AND] = "AND Vx, Vy",
+      [OP_XOR] = "XOR Vx, Vy",
+      [OP_ADD_REG] = "ADD Vx, Vy",
+      [OP_SUB] = "SUB Vx, Vy",
+      [OP_SHR] = "SHR Vx, Vy",
+      [OP_SUBN] = "SUBN Vx, Vy",
+      [OP_SHL] = "SHL Vx, Vy",
+      [OP_SNE_REG] = "SNE Vx, Vy",
+      [OP_LD_I] = "LD I, addr",
+      [OP_JP_V0] = "JP V0, addr",
+      [OP_RND] = "RND Vx, byte",
+      [OP_DRW] = "DRW Vx, Vy, n",
+      [OP_SKP] = "SKP Vx",
+      [OP_SKNP] = "SKNP Vx",
+      [OP_LD_VX_DT] = "LD Vx, DT",
+      [OP_LD_KEY] = "LD Vx, K",
+      [OP_LD_DT] = "LD DT, Vx",
+      [OP_LD_ST] = "LD ST, Vx",
+      [OP_ADD_I] = "ADD I, Vx",
+      [OP_LD_FONT] = "LD F, Vx",
+      [OP_LD_BCD] = "LD B, Vx",
+      [OP_STORE] = "LD [I], Vx",
+      [OP_LOAD] = "LD Vx, [I]",
+      [OP_UNKNOWN] = "DW word",
+  };
+
+  return names[opcodeClass];
+}
+
+void disassemble(const uint16_t opcode, char *buffer, const size_t size) {
+  const uint16_t nnn = opcode & 0x0FFF;
+  const uint8_t n = opcode & 0x000F;
+  const uint8_t x = (opcode >> 8) & 0x000F;
+  const uint8_t y = (opcode >> 4) & 0x000F;
+  const uint8_t kk = opcode & 0x00FF;
+
+  switch (opcodeClass(opcode)) {
+    case OP_CLS:
+      snprintf(buffer, size, "CLS");
+      break;
+    case OP_RET:
+      snprintf(buffer, size, "RET");
+      break;
+    case OP_SYS:
+      snprintf(buffer, size, "SYS 0x%03X", nnn);
+      break;
+    case OP_JP:
+      snprintf(buffer, size, "JP 0x%03X", nnn);
+      break;
+    case OP_CALL:
+      snprintf(buffer, size, "CALL 0x%03X", nnn);
+      break;
+    case OP_SE_BYTE:
+      snprintf(buffer, size, "SE V%X, 0x%02X", x, kk);
+      break;
+    case OP_SNE_BYTE:
+      snprintf(buffer, size, "SNE V%X, 0x%02X", x, kk);
+      break;
+    case OP_SE_REG:
+      snprintf(buffer, size, "SE V%X, V%X", x, y);
+      break;
+    case OP_LD_BYTE:
+      snprintf(buffer, size, "LD V%X, 0x%02X", x, kk);
+      break;
+    case OP_ADD_BYTE:
+      snprintf(buffer, size, "ADD V%X, 0x%02X", x, kk);
+      break;
+    case OP_LD_REG:
+      snprintf(buffer, size, "LD V%X, V%X", x, y);
+      break;
+    case OP_OR:
+      snprintf(buffer, size, "OR V%X, V%X", x, y);
+      break;
+    case OP_AND:
+      snprintf(buffer, size, "AND V%X, V%X", x, y);
+      break;
+    case OP_XOR:
+      snprintf(buffer, size, "XOR V%X, V%X", x, y);
+      break;
+    case OP_ADD_REG:
+      snprintf(buffer, size, "ADD V%X, V%X", x, y);
+      break;
+    case OP_SUB:
+      snprintf(buffer, size, "SUB V%X, V%X", x, y);
+      break;
+    case OP_SHR:
+      snprintf(buffer, size, "SHR V%X, V%X", x, y);
+      break;
+    case OP_SUBN:
+      snprintf(buffer, size, "SUBN V%X, V%X", x, y);
+      break;
+    case OP_SHL:
+      snprintf(buffer, size, "SHL V%X, V%X", x, y);
+      break;
+    case OP_SNE_REG:
+      snprintf(buffer, size, "SNE V%X, V%X", x, y);
+      break;
+    case OP_LD_I:
+      snprintf(buffer, size, "LD I, 0x%03X", nnn);
+      break;
+    case OP_JP_V0:
+      snprintf(buffer, size, "JP V0, 0x%03X", nnn);
+      break;
+    case OP_RND:
+      snprintf(buffer, size, "RND V%X, 0x%02X", x, kk);
+      break;
+    case OP_DRW:
+      snprintf(buffer, size, "DRW V%X, V%X, %u", x, y, n);
+      break;
+    case OP_SKP:
+      snprintf(buffer, size, "SKP V%X", x);
+      break;
+    case OP_SKNP:
+      snprintf(buffer, size, "SKNP V%X", x);
+      break;
+    case OP_LD_VX_DT:
+      snprintf(buffer, size, "LD V%X, DT", x);
+      break;
+    case OP_LD_KEY:
+      snprintf(buffer, size, "LD V%X, K", x);
+      break;
+    case OP_LD_DT:
+      snprintf(buffer, size, "LD DT, V%X", x);
+      break;
+    case OP_LD_ST:
+      snprintf(buffer, size, "LD ST, V%X", x);
+      break;
+    case OP_ADD_I:
+      snprintf(buffer, size, "ADD I, V%X", x);
+      break;
+    case OP_LD_FONT:
+      snprintf(buffer, size, "LD F, V%X", x);
+      break;
+    case OP_LD_BCD:
+      snprintf(buffer, size, "LD B, V%X", x);
+      break;
+    case OP_STORE:
+      snprintf(buffer, size, "LD [I], V%X", x);
+      break;
+    case OP_LOAD:
+      snprintf(buffer, size, "LD V%X, [I]", x);
+      break;
+    default:
+      snprintf(buffer, size, "DW 0x%04X", opcode);
+      break;
+  }
+}
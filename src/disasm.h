@@ -0,0 +1,68 @@
+#pragma once
+
+// std
+#include <stddef.h>
+#include <stdint.h>
+
+// Instruction classes as executed by the interpreter
+typedef enum {
+  OP_CLS = 0,
+  OP_RET,
+  OP_SYS,
+  OP_JP,
+  OP_CALL,
+  OP_SE_BYTE,
+  OP_SNE_BYTE,
+  OP_SE_REG,
+  OP_LD_BYTE,
+  OP_ADD_BYTE,
+  OP_LD_REG,
+  OP_OR,
+  OP_AND,
+  OP_XOR,
+  OP_ADD_REG,
+  OP_SUB,
+  OP_SHR,
+  OP_SUBN,
+  OP_SHL,
+  OP_SNE_REG,
+  OP_LD_I,
+  OP_JP_V0,
+  OP_RND,
+  OP_DRW,
+  OP_SKP,
+  OP_SKNP,
+  OP_LD_VX_DT,
+  OP_LD_KEY,
+  OP_LD_DT,
+  OP_LD_ST,
+  OP_ADD_I,
+  OP_LD_FONT,
+  OP_LD_BCD,
+  OP_STORE,
+  OP_LOAD,
+  OP_UNKNOWN,
+  OP_COUNT
+} OpcodeClass;
+
+/**
+ * Classifies the opcode the same way the interpreter decodes it.
+ * @param opcode - the raw opcode
+ * @return the opcode class
+ */
+OpcodeClass opcodeClass(const uint16_t opcode);
+
+/**
+ * Gets the mnemonic of the opcode class, e.g. "LD Vx, byte".
+ * @param opcodeClass - the opcode class
+ * @return the mnemonic
+ */
+const char* opcodeClassName(const OpcodeClass opcodeClass);
+
+/**
+ * Formats the opcode in Cowgod's assembly syntax, e.g. "LD V3, 0x2A".
+ * @param opcode - the raw opcode
+ * @param buffer - the buffer to write to
+ * @param size - the size of the buffer
+ */
+void disassemble(const uint16_t opcode, char* buffer, const size_t size);
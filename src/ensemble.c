@@ -0,0 +1,518 @@
+#include "ensemble.h"
+
+// std
+#include <stdio.h>
+#include <string.h>
+
+bool initEnsemble(Ensemble *ensemble, const Chip8 *chip8,
+                  const uint32_t count) {
+  if (count == 0 || count > ENSEMBLE_LANES) {
+    fprintf(stderr, "Ensembles hold 1 to %u instances\n", ENSEMBLE_LANES);
+    return false;
+  }
+
+  memset(ensemble, 0, sizeof(*ensemble));
+  ensemble->count = count;
+  ensemble->quirks = quirksOf(chip8->profile);
+
+  for (uint32_t lane = 0; lane < count; lane++) {
+    Chip8 *instance = &ensemble->instances[lane];
+    memcpy(instance, chip8, CHIP8_STATE_SIZE);
+    instance->state = RUNNING;
+    setProfile(instance, chip8->profile);
+  }
+
+  return true;
+}
+
+// Records a store to ram, after which instances may hold different code at
+// those addresses
+static void markStored(Ensemble *ensemble, const uint16_t index,
+                       const uint8_t length) {
+  for (uint8_t i = 0; i < length; i++) {
+    const uint16_t address = (index + i) & (RAM_SIZE - 1);
+    ensemble->stored[address / 64] |= 1ull << address % 64;
+  }
+}
+
+// Keeps up the write barrier of the core for stores executed together
+static void markDirty(Chip8 *chip8, const uint16_t index,
+                      const uint8_t length) {
+  const uint16_t last = index + length - 1;
+  chip8->dirtyPages |= 1u << (index & (RAM_SIZE - 1)) / DIRTY_PAGE_SIZE;
+  chip8->dirtyPages |= 1u << (last & (RAM_SIZE - 1)) / DIRTY_PAGE_SIZE;
+}
+
+static bool isStored(const Ensemble *ensemble, const uint16_t address) {
+  return ensemble->stored[address / 64] >> address % 64 & 1;
+}
+
+void restoreInstance(Ensemble *ensemble, const uint32_t lane,
+                     const uint8_t *state) {
+  Chip8 *chip8 = &ensemble->instances[lane];
+  const uint8_t *ram = state + offsetof(Chip8, ram);
+
+  // Ram outside the stored bytes is the same on every instance, so only
+  // what the new state changes can differ
+  for (uint16_t address = 0; address < RAM_SIZE; address++) {
+    if (ram[address] != chip8->ram[address]) {
+      markStored(ensemble, address, 1);
+    }
+  }
+
+  memcpy(chip8, state, CHIP8_STATE_SIZE);
+  chip8->dirtyPages = ALL_DIRTY_PAGES;
+}
+
+// Moves the registers of every instance into the arrays
+static void loadRegisters(Ensemble *ensemble) {
+  for (uint32_t lane = 0; lane < ENSEMBLE_LANES; lane++) {
+    const Chip8 *chip8 = &ensemble->instances[lane];
+
+    for (uint32_t i = 0; i < NUM_REGISTERS; i++) {
+      ensemble->V[i][lane] = chip8->V[i];
+    }
+    ensemble->indexRegister[lane] = chip8->indexRegister;
+    ensemble->programCounter[lane] = chip8->programCounter;
+    ensemble->delayTimer[lane] = chip8->delayTimer;
+    ensemble->soundTimer[lane] = chip8->soundTimer;
+  }
+}
+
+// Moves the registers back, along with the last instruction, and counts
+// the cycles of the frame
+static void storeRegisters(Ensemble *ensemble, const uint32_t instructions) {
+  for (uint32_t lane = 0; lane < ensemble->count; lane++) {
+    Chip8 *chip8 = &ensemble->instances[lane];
+
+    for (uint32_t i = 0; i < NUM_REGISTERS; i++) {
+      chip8->V[i] = ensemble->V[i][lane];
+    }
+    chip8->indexRegister = ensemble->indexRegister[lane];
+    chip8->programCounter = ensemble->programCounter[lane];
+    chip8->delayTimer = ensemble->delayTimer[lane];
+    chip8->soundTimer = ensemble->soundTimer[lane];
+    chip8->cycles += instructions;
+
+    if (instructions) {
+      const uint16_t raw = ensemble->opcode[lane];
+      chip8->instruction = (Instruction){
+          .raw = raw,
+          .nnn = raw & 0x0FFF,
+          .n = raw & 0x000F,
+          .x = (raw >> 8) & 0x000F,
+          .y = (raw >> 4) & 0x000F,
+          .kk = raw & 0x00FF,
+      };
+    }
+  }
+}
+
+// Executes the next instruction of a single instance through its
+// interpreter
+static void stepInstance(Ensemble *ensemble, const uint32_t lane) {
+  Chip8 *chip8 = &ensemble->instances[lane];
+
+  for (uint32_t i = 0; i < NUM_REGISTERS; i++) {
+    chip8->V[i] = ensemble->V[i][lane];
+  }
+  chip8->indexRegister = ensemble->indexRegister[lane];
+  chip8->programCounter = ensemble->programCounter[lane];
+  chip8->delayTimer = ensemble->delayTimer[lane];
+  chip8->soundTimer = ensemble->soundTimer[lane];
+
+  // The cycles of the whole frame are counted when the registers are stored
+  const uint64_t cycles = chip8->cycles;
+  const uint16_t index = chip8->indexRegister;
+  chip8->interpreter(chip8);
+  chip8->cycles = cycles;
+
+  switch (chip8->instruction.raw & 0xF0FF) {
+    case 0xF033:
+      markStored(ensemble, index, 3);
+      break;
+    case 0xF055:
+      markStored(ensemble, index, chip8->instruction.x + 1);
+      break;
+  }
+
+  for (uint32_t i = 0; i < NUM_REGISTERS; i++) {
+    ensemble->V[i][lane] = chip8->V[i];
+  }
+  ensemble->indexRegister[lane] = chip8->indexRegister;
+  ensemble->programCounter[lane] = chip8->programCounter;
+  ensemble->delayTimer[lane] = chip8->delayTimer;
+  ensemble->soundTimer[lane] = chip8->soundTimer;
+  ensemble->opcode[lane] = chip8->instruction.raw;
+  ensemble->budget[lane]--;
+  ensemble->scalarInstructions++;
+}
+
+// Instructions that only touch registers, the stack, ram and the keypad,
+// executed together. Those that always fault run on the instances
+static bool isVectorInstruction(const uint16_t opcode) {
+  switch (opcode >> 12) {
+    case 0x0:
+      return opcode == 0x00EE;
+    case 0x5:
+    case 0x9:
+      return (opcode & 0x000F) == 0;
+    case 0x8:
+      return (opcode & 0x000F) <= 0x7 || (opcode & 0x000F) == 0xE;
+    case 0x1:
+    case 0x2:
+    case 0x3:
+    case 0x4:
+    case 0x6:
+    case 0x7:
+    case 0xA:
+    case 0xB:
+      return true;
+    case 0xE:
+      return (opcode & 0x00FF) == 0x9E || (opcode & 0x00FF) == 0xA1;
+    case 0xF:
+      switch (opcode & 0x00FF) {
+        case 0x07:
+        case 0x15:
+        case 0x18:
+        case 0x1E:
+        case 0x29:
+        case 0x33:
+        case 0x55:
+        case 0x65:
+          return true;
+      }
+      return false;
+    default:
+      return false;
+  }
+}
+
+// Lane operations as macros rather than functions, as passing vectors by
+// value depends on the instruction set the build targets. Masks have every
+// bit of a lane set or clear, and are built with arithmetic because
+// comparing vectors wider than the target's registers compiles lane by lane
+
+// Keeps the lanes of a where the mask is set and those of b elsewhere
+#define BLEND(mask, a, b) (((a) & (mask)) | ((b) & ~(mask)))
+
+// Mask of the lanes equal to zero
+#define IS_ZERO(lanes, bits) ((((lanes) | -(lanes)) >> ((bits) - 1)) - 1)
+
+// One in the lanes where a is above b, the borrow out of b - a
+#define IS_ABOVE(a, b) (((~(b) & (a)) | (~((a) ^ (b)) & ((b) - (a)))) >> 7)
+
+// One in the lanes where a + b carries
+#define CARRY(a, b) ((((a) & (b)) | (((a) | (b)) & ~((a) + (b)))) >> 7)
+
+// Whether the instruction faults on the instance, checked as the
+// interpreter in core.c does
+static bool faultsOn(const Ensemble *ensemble, const uint32_t lane,
+                     const uint16_t opcode) {
+  const uint8_t x = (opcode >> 8) & 0x000F;
+  const uint16_t index = ensemble->indexRegister[lane];
+
+  switch (opcode >> 12) {
+    case 0x0:
+      return ensemble->instances[lane].stackDepth == 0;
+    case 0x2:
+      return ensemble->instances[lane].stackDepth == STACK_SIZE;
+    case 0xE:
+      return ensemble->V[x][lane] >= KEYS;
+    case 0xF:
+      return (opcode & 0x00FF) == 0x33 ? index + 3 > RAM_SIZE
+                                       : index + x >= RAM_SIZE;
+    default:
+      return false;
+  }
+}
+
+// Runs the instruction through the interpreters of the instances it faults
+// on, which record the faults, and takes those instances out of the mask
+static void stepFaulting(Ensemble *ensemble, WordLanes *mask,
+                         const uint16_t opcode) {
+  const uint8_t group = opcode >> 12;
+  const uint8_t kk = opcode & 0x00FF;
+
+  // Only the stack, the keypad and ram through the index register fault
+  if (group != 0x0 && group != 0x2 && group != 0xE &&
+      !(group == 0xF && (kk == 0x33 || kk == 0x55 || kk == 0x65))) {
+    return;
+  }
+
+  for (uint32_t l = 0; l < ENSEMBLE_LANES; l++) {
+    if ((*mask)[l] && faultsOn(ensemble, l, opcode)) {
+      stepInstance(ensemble, l);
+      (*mask)[l] = 0;
+    }
+  }
+}
+
+// Executes the instruction on every instance in the mask, matching the
+// interpreter in core.c statement for statement. Every lane computes the
+// result and the mask selects which keep it, except for the stack, ram and
+// the keypad which each instance keeps in its own state
+static void executeVector(Ensemble *ensemble, const WordLanes *lanes,
+                          const uint16_t opcode) {
+  const uint8_t x = (opcode >> 8) & 0x000F;
+  const uint8_t y = (opcode >> 4) & 0x000F;
+  const uint8_t kk = opcode & 0x00FF;
+  const uint16_t nnn = opcode & 0x0FFF;
+  const Quirks quirks = ensemble->quirks;
+  const WordLanes mask = *lanes;
+  const ByteLanes bytes = __builtin_convertvector(mask, ByteLanes);
+  const ByteLanes zeroBytes = {0};
+  const WordLanes zeroWords = {0};
+  ByteLanes *V = ensemble->V;
+  WordLanes *pc = &ensemble->programCounter;
+  WordLanes *index = &ensemble->indexRegister;
+  Chip8 *instances = ensemble->instances;
+
+  ensemble->opcode = BLEND(mask, zeroWords + opcode, ensemble->opcode);
+  ensemble->budget += mask;
+
+  switch (opcode >> 12) {
+    case 0x0:
+      for (uint32_t l = 0; l < ENSEMBLE_LANES; l++) {
+        if (!mask[l]) continue;
+        Chip8 *chip8 = &instances[l];
+        chip8->stackPointer = (chip8->stackPointer - 1) & (STACK_SIZE - 1);
+        chip8->stackDepth--;
+        (*pc)[l] = chip8->stack[chip8->stackPointer];
+      }
+      break;
+    case 0x1:
+      *pc = BLEND(mask, zeroWords + nnn, *pc);
+      break;
+    case 0x2:
+      for (uint32_t l = 0; l < ENSEMBLE_LANES; l++) {
+        if (!mask[l]) continue;
+        Chip8 *chip8 = &instances[l];
+        chip8->stack[chip8->stackPointer] = (*pc)[l];
+        chip8->stackPointer = (chip8->stackPointer + 1) & (STACK_SIZE - 1);
+        chip8->stackDepth++;
+      }
+      *pc = BLEND(mask, zeroWords + nnn, *pc);
+      break;
+    case 0x3:
+    case 0x4:
+    case 0x5:
+    case 0x9: {
+      // 3XKK and 5XY0 skip when equal, 4XKK and 9XY0 when not
+      const uint8_t group = opcode >> 12;
+      const ByteLanes operand =
+          group == 0x3 || group == 0x4 ? zeroBytes + kk : V[y];
+      ByteLanes skip = IS_ZERO(V[x] ^ operand, 8);
+      if (group == 0x4 || group == 0x9) skip = ~skip;
+      *pc += __builtin_convertvector(bytes & skip, WordLanes) & 2;
+    } break;
+    case 0x6:
+      V[x] = BLEND(bytes, zeroBytes + kk, V[x]);
+      break;
+    case 0x7:
+      V[x] += (zeroBytes + kk) & bytes;
+      break;
+    case 0x8:
+      switch (opcode & 0x000F) {
+        case 0x0:
+          V[x] = BLEND(bytes, V[y], V[x]);
+          break;
+        case 0x1:
+          V[x] = BLEND(bytes, V[x] | V[y], V[x]);
+          if (quirks.vfReset) V[0xF] = BLEND(bytes, zeroBytes, V[0xF]);
+          break;
+        case 0x2:
+          V[x] = BLEND(bytes, V[x] & V[y], V[x]);
+          if (quirks.vfReset) V[0xF] = BLEND(bytes, zeroBytes, V[0xF]);
+          break;
+        case 0x3:
+          V[x] = BLEND(bytes, V[x] ^ V[y], V[x]);
+          if (quirks.vfReset) V[0xF] = BLEND(bytes, zeroBytes, V[0xF]);
+          break;
+        case 0x4: {
+          const ByteLanes carry = CARRY(V[x], V[y]);
+          V[x] = BLEND(bytes, V[x] + V[y], V[x]);
+          V[0xF] = BLEND(bytes, carry, V[0xF]);
+        } break;
+        case 0x5:
+          // V[F] is written first and read back when X or Y is F
+          V[0xF] = BLEND(bytes, IS_ABOVE(V[x], V[y]), V[0xF]);
+          V[x] = BLEND(bytes, V[x] - V[y], V[x]);
+          break;
+        case 0x6: {
+          const ByteLanes source = quirks.shift ? V[x] : V[y];
+          V[x] = BLEND(bytes, source >> 1, V[x]);
+          V[0xF] = BLEND(bytes, source & 1, V[0xF]);
+        } break;
+        case 0x7:
+          V[0xF] = BLEND(bytes, IS_ABOVE(V[y], V[x]), V[0xF]);
+          V[x] = BLEND(bytes, V[y] - V[x], V[x]);
+          break;
+        case 0xE: {
+          const ByteLanes source = quirks.shift ? V[x] : V[y];
+          V[x] = BLEND(bytes, source << 1, V[x]);
+          V[0xF] = BLEND(bytes, source >> 7, V[0xF]);
+        } break;
+      }
+      break;
+    case 0xA:
+      *index = BLEND(mask, zeroWords + nnn, *index);
+      break;
+    case 0xB: {
+      // With the jump quirk X is the top nibble of NNN
+      const ByteLanes offset = quirks.jump ? V[x] : V[0x0];
+      *pc = BLEND(mask, __builtin_convertvector(offset, WordLanes) + nnn, *pc);
+    } break;
+    case 0xE:
+      // Only the low nibble of V[X] selects the key
+      for (uint32_t l = 0; l < ENSEMBLE_LANES; l++) {
+        if (!mask[l]) continue;
+        const bool pressed = instances[l].keypad[V[x][l] & (KEYS - 1)];
+        (*pc)[l] += pressed == (kk == 0x9E) ? 2 : 0;
+      }
+      break;
+    case 0xF:
+      switch (kk) {
+        case 0x07:
+          V[x] = BLEND(bytes, ensemble->delayTimer, V[x]);
+          break;
+        case 0x15:
+          ensemble->delayTimer = BLEND(bytes, V[x], ensemble->delayTimer);
+          break;
+        case 0x18:
+          ensemble->soundTimer = BLEND(bytes, V[x], ensemble->soundTimer);
+          break;
+        case 0x1E:
+          *index += __builtin_convertvector(V[x], WordLanes) & mask;
+          break;
+        case 0x29:
+          *index = BLEND(mask, __builtin_convertvector(V[x], WordLanes) * 5,
+                         *index);
+          break;
+        case 0x33:
+          for (uint32_t l = 0; l < ENSEMBLE_LANES; l++) {
+            if (!mask[l]) continue;
+            uint8_t *ram = instances[l].ram;
+            const uint16_t address = (*index)[l];
+            uint8_t bcd = V[x][l];
+            ram[(address + 2) & (RAM_SIZE - 1)] = bcd % 10;
+            bcd /= 10;
+            ram[(address + 1) & (RAM_SIZE - 1)] = bcd % 10;
+            bcd /= 10;
+            ram[address & (RAM_SIZE - 1)] = bcd;
+            markStored(ensemble, address, 3);
+            markDirty(&instances[l], address, 3);
+          }
+          break;
+        case 0x55:
+        case 0x65:
+          for (uint32_t l = 0; l < ENSEMBLE_LANES; l++) {
+            if (!mask[l]) continue;
+            uint8_t *ram = instances[l].ram;
+            const uint16_t address = (*index)[l];
+            for (uint8_t i = 0; i <= x; i++) {
+              if (kk == 0x55) {
+                ram[(address + i) & (RAM_SIZE - 1)] = V[i][l];
+              } else {
+                V[i][l] = ram[(address + i) & (RAM_SIZE - 1)];
+              }
+            }
+            if (kk == 0x55) {
+              markStored(ensemble, address, x + 1);
+              markDirty(&instances[l], address, x + 1);
+            }
+          }
+          if (quirks.memory) {
+            const uint16_t increment = x + !quirks.memoryIncrementByX;
+            *index += (zeroWords + increment) & mask;
+          }
+          break;
+      }
+      break;
+  }
+}
+
+// Runs every instance until its budget is spent
+static void runInstructions(Ensemble *ensemble) {
+  for (;;) {
+    // The instances furthest behind go next, so the others wait for them
+    // and those split by a skip or a jump forward run together again.
+    // Instances without instructions left wait at the end of the address
+    // space
+    const WordLanes waiting =
+        ensemble->programCounter | IS_ZERO(ensemble->budget, 16);
+
+    uint16_t lowest = UINT16_MAX;
+    for (uint32_t l = 0; l < ENSEMBLE_LANES; l++) {
+      lowest = waiting[l] < lowest ? waiting[l] : lowest;
+    }
+
+    if (lowest == UINT16_MAX) break;
+
+    WordLanes mask = IS_ZERO(waiting ^ lowest, 16);
+    uint32_t leader = 0;
+    while (!mask[leader]) leader++;
+
+    // Fetched as nextInstruction does, from the first instance there
+    const uint16_t address = lowest & (RAM_SIZE - 1);
+    const uint16_t next = (address + 1) & (RAM_SIZE - 1);
+    const uint8_t *ram = ensemble->instances[leader].ram;
+    const uint16_t opcode = ram[address] << 8 | ram[next];
+
+    // Instances that stored other code at the address run it on their own
+    if (isStored(ensemble, address) || isStored(ensemble, next)) {
+      for (uint32_t l = leader + 1; l < ENSEMBLE_LANES; l++) {
+        if (!mask[l]) continue;
+
+        const uint8_t *laneRam = ensemble->instances[l].ram;
+        if (laneRam[address] != ram[address] || laneRam[next] != ram[next]) {
+          stepInstance(ensemble, l);
+          mask[l] = 0;
+        }
+      }
+    }
+
+    if (isVectorInstruction(opcode)) {
+      stepFaulting(ensemble, &mask, opcode);
+
+      const WordLanes zeroWords = {0};
+      const uint16_t after = address + 2;
+      ensemble->programCounter = BLEND(mask, zeroWords + after,
+                                       ensemble->programCounter);
+      executeVector(ensemble, &mask, opcode);
+    } else {
+      for (uint32_t l = leader; l < ENSEMBLE_LANES; l++) {
+        if (mask[l]) stepInstance(ensemble, l);
+      }
+    }
+  }
+}
+
+void runEnsembleInstructions(Ensemble *ensemble, const uint32_t instructions) {
+  const uint64_t scalar = ensemble->scalarInstructions;
+
+  loadRegisters(ensemble);
+
+  // Budgets are counted per lane in 16 bits
+  for (uint32_t remaining = instructions; remaining;) {
+    const uint16_t chunk = remaining < UINT16_MAX ? remaining : UINT16_MAX;
+    for (uint32_t lane = 0; lane < ENSEMBLE_LANES; lane++) {
+      ensemble->budget[lane] = lane < ensemble->count ? chunk : 0;
+    }
+    runInstructions(ensemble);
+    remaining -= chunk;
+  }
+
+  storeRegisters(ensemble, instructions);
+
+  ensemble->vectorInstructions += (uint64_t)ensemble->count * instructions -
+                                  (ensemble->scalarInstructions - scalar);
+}
+
+void runEnsembleFrame(Ensemble *ensemble, const uint32_t instructions) {
+  runEnsembleInstructions(ensemble, instructions);
+
+  for (uint32_t lane = 0; lane < ensemble->count; lane++) {
+    updateTimers(&ensemble->instances[lane]);
+  }
+}
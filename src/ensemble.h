@@ -0,0 +1,82 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+
+// Instances run in lockstep, one byte per instance fills an AVX2 register
+#define ENSEMBLE_LANES 32
+
+// Registers of every instance as GCC and Clang vectors, lowered to SSE2,
+// AVX2, AVX-512, NEON or scalar code for whatever the build targets
+typedef uint8_t ByteLanes __attribute__((vector_size(ENSEMBLE_LANES)));
+typedef uint16_t WordLanes __attribute__((vector_size(ENSEMBLE_LANES * 2)));
+
+// Instances of the same rom differing only in input. While a frame runs
+// their registers live in structure of arrays form, and every instance at
+// the lowest program counter executes the instruction there together, so
+// instances that split on a skip join up again once the others catch up.
+// Calls, returns, loads, stores and key skips reach into each instance's own
+// stack, ram and keypad. Drawing, waiting for a key, random numbers and
+// instructions that fault on an instance run on it through its interpreter,
+// which records the fault
+typedef struct {
+  ByteLanes V[NUM_REGISTERS];
+  WordLanes indexRegister;
+  WordLanes programCounter;
+  ByteLanes delayTimer;
+  ByteLanes soundTimer;
+  // Last instruction and instructions left to execute this frame
+  WordLanes opcode;
+  WordLanes budget;
+  uint32_t count;
+  Quirks quirks;
+  // Bytes of ram any instance has stored to, where the code of each
+  // instance is compared before executing it together
+  uint64_t stored[RAM_SIZE / 64];
+  // Instructions executed together and on their own
+  uint64_t vectorInstructions;
+  uint64_t scalarInstructions;
+  // Full state of every instance, current between frames
+  Chip8 instances[ENSEMBLE_LANES];
+} Ensemble;
+
+/**
+ * Copies the machine state of the emulator, with the rom loaded and the
+ * profile selected, into every instance. Instances may be seeded and given
+ * their own input through the instances array afterwards.
+ * @param ensemble - the ensemble
+ * @param chip8 - the emulator state to copy
+ * @param count - the number of instances, up to ENSEMBLE_LANES
+ * @return true if the count fits, false otherwise
+ */
+bool initEnsemble(Ensemble* ensemble, const Chip8* chip8,
+                  const uint32_t count);
+
+/**
+ * Restores the machine state of one instance between frames, keeping track
+ * of the ram it no longer shares with the others.
+ * @param ensemble - the ensemble
+ * @param lane - the instance
+ * @param state - CHIP8_STATE_SIZE bytes of machine state of the same rom
+ */
+void restoreInstance(Ensemble* ensemble, const uint32_t lane,
+                     const uint8_t* state);
+
+/**
+ * Executes the given number of instructions on every instance without
+ * updating the timers, part of a frame as an engine under test runs it.
+ * @param ensemble - the ensemble
+ * @param instructions - the number of instructions
+ */
+void runEnsembleInstructions(Ensemble* ensemble, const uint32_t instructions);
+
+/**
+ * Runs a frame on every instance by executing the given number of
+ * instructions and then updating the timers, leaving every instance as
+ * runFrame would.
+ * @param ensemble - the ensemble
+ * @param instructions - the number of instructions per frame
+ */
+void runEnsembleFrame(Ensemble* ensemble, const uint32_t instructions);
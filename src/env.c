@@ -0,0 +1,138 @@
+#include "env.h"
+
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t ensembleCount(const Environments *environments) {
+  return (environments->count + ENSEMBLE_LANES - 1) / ENSEMBLE_LANES;
+}
+
+static Chip8 *instanceOf(const Environments *environments,
+                         const uint32_t index) {
+  Ensemble *ensemble = &environments->ensembles[index / ENSEMBLE_LANES];
+  return &ensemble->instances[index % ENSEMBLE_LANES];
+}
+
+static uint32_t readProbe(const RewardProbe probe, const uint8_t *ram) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < probe.size; i++) {
+    value = value << 8 | ram[(probe.address + i) & (RAM_SIZE - 1)];
+  }
+  return value;
+}
+
+static void observe(Environments *environments, const uint32_t index,
+                    Observation *observation) {
+  const Chip8 *chip8 = instanceOf(environments, index);
+  const uint32_t probe = readProbe(environments->probe, chip8->ram);
+
+  observation->frameBuffer = chip8->frameBuffer;
+  observation->soundTimer = chip8->soundTimer;
+  observation->probe = probe;
+  observation->reward = (int64_t)probe - environments->probes[index];
+  environments->probes[index] = probe;
+}
+
+bool initEnvironments(Environments *environments, const Chip8 *chip8,
+                      const uint32_t count,
+                      const uint32_t instructionsPerFrame,
+                      const RewardProbe probe) {
+  if (count == 0 || probe.size > sizeof(uint32_t)) {
+    fprintf(stderr, "Environments need a count and a probe of 0 to 4 bytes\n");
+    return false;
+  }
+
+  *environments = (Environments){0};
+  environments->count = count;
+  environments->instructionsPerFrame = instructionsPerFrame;
+  environments->probe = probe;
+  memcpy(environments->initial, chip8, CHIP8_STATE_SIZE);
+
+  const uint32_t ensembles = ensembleCount(environments);
+  environments->ensembles =
+      aligned_alloc(_Alignof(Ensemble), ensembles * sizeof(Ensemble));
+  environments->probes = calloc(count, sizeof(*environments->probes));
+
+  if (environments->ensembles == NULL || environments->probes == NULL) {
+    destroyEnvironments(environments);
+    return false;
+  }
+
+  for (uint32_t i = 0; i < ensembles; i++) {
+    const uint32_t lanes = count - i * ENSEMBLE_LANES;
+    initEnsemble(&environments->ensembles[i], chip8,
+                 lanes < ENSEMBLE_LANES ? lanes : ENSEMBLE_LANES);
+  }
+
+  const uint32_t initialProbe = readProbe(probe, chip8->ram);
+  for (uint32_t i = 0; i < count; i++) {
+    environments->probes[i] = initialProbe;
+  }
+
+  return true;
+}
+
+void resetEnvironment(Environments *environments, const uint32_t index,
+                      const uint32_t seed, Observation *observation) {
+  Ensemble *ensemble = &environments->ensembles[index / ENSEMBLE_LANES];
+  restoreInstance(ensemble, index % ENSEMBLE_LANES, environments->initial);
+  seedRandom(instanceOf(environments, index), seed);
+
+  // A reset starts the reward over
+  environments->probes[index] =
+      readProbe(environments->probe, instanceOf(environments, index)->ram);
+  observe(environments, index, observation);
+}
+
+void resetEnvironments(Environments *environments, const uint32_t seed,
+                       Observation *observations) {
+  for (uint32_t i = 0; i < environments->count; i++) {
+    resetEnvironment(environments, i, seed + i, &observations[i]);
+  }
+}
+
+void stepEnvironments(Environments *environments, const uint16_t *actions,
+                      const uint32_t frames, Observation *observations) {
+  // Each ensemble runs all its frames at once while it is in cache
+  for (uint32_t i = 0; i < ensembleCount(environments); i++) {
+    Ensemble *ensemble = &environments->ensembles[i];
+
+    for (uint32_t lane = 0; lane < ensemble->count; lane++) {
+      setKeypadState(&ensemble->instances[lane],
+                     actions[i * ENSEMBLE_LANES + lane]);
+    }
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      runEnsembleFrame(ensemble, environments->instructionsPerFrame);
+    }
+  }
+
+  for (uint32_t i = 0; i < environments->count; i++) {
+    observe(environments, i, &observations[i]);
+  }
+}
+
+void cloneEnvironment(const Environments *environments, const uint32_t index,
+                      uint8_t *state) {
+  memcpy(state, instanceOf(environments, index), CHIP8_STATE_SIZE);
+}
+
+void restoreEnvironment(Environments *environments, const uint32_t index,
+                        const uint8_t *state, Observation *observation) {
+  Ensemble *ensemble = &environments->ensembles[index / ENSEMBLE_LANES];
+  restoreInstance(ensemble, index % ENSEMBLE_LANES, state);
+
+  // The reward continues from the restored score
+  environments->probes[index] =
+      readProbe(environments->probe, instanceOf(environments, index)->ram);
+  observe(environments, index, observation);
+}
+
+void destroyEnvironments(Environments *environments) {
+  free(environments->ensembles);
+  free(environments->probes);
+  environments->ensembles = NULL;
+  environments->probes = NULL;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "core.h"
+#include "ensemble.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+
+// Size of an environment snapshot taken by cloneEnvironment
+#define ENV_STATE_SIZE CHIP8_STATE_SIZE
+
+// Ram holding the score the reward is computed from, read as a big endian
+// value of up to 4 bytes. A size of 0 gives no reward
+typedef struct {
+  uint16_t address;
+  uint8_t size;
+} RewardProbe;
+
+// What an environment shows after a reset or a step
+typedef struct {
+  // WINDOW_WIDTH * WINDOW_HEIGHT pixels of 0 or 1, aliasing the environment
+  // until it is next stepped, reset or restored
+  const uint8_t* frameBuffer;
+  uint8_t soundTimer;
+  uint32_t probe;
+  // Change of the probe since the previous observation
+  int64_t reward;
+} Observation;
+
+// Batch of environments running the same rom, stepped together without
+// SDL. Environments are grouped into ensembles so every frame runs them in
+// lockstep, and everything is allocated once up front. Batches share no
+// state, so separate batches can be stepped from separate threads
+typedef struct {
+  Ensemble* ensembles;
+  uint32_t count;
+  uint32_t instructionsPerFrame;
+  RewardProbe probe;
+  uint32_t* probes;
+  // Machine state right after loading the rom, restored by a reset
+  uint8_t initial[CHIP8_STATE_SIZE];
+} Environments;
+
+/**
+ * Allocates a batch of environments starting from the emulator state,
+ * which should have the rom loaded and the profile selected.
+ * @param environments - the batch of environments
+ * @param chip8 - the emulator state every environment starts from
+ * @param count - the number of environments
+ * @param instructionsPerFrame - the number of instructions per frame
+ * @param probe - the ram the reward is computed from
+ * @return true if allocation was successful, false otherwise
+ */
+bool initEnvironments(Environments* environments, const Chip8* chip8,
+                      const uint32_t count,
+                      const uint32_t instructionsPerFrame,
+                      const RewardProbe probe);
+
+/**
+ * Resets an environment to the state right after loading the rom.
+ * @param environments - the batch of environments
+ * @param index - the environment
+ * @param seed - the seed of its random number generator
+ * @param observation - the observation of the environment
+ */
+void resetEnvironment(Environments* environments, const uint32_t index,
+                      const uint32_t seed, Observation* observation);
+
+/**
+ * Resets every environment, seeding each with seed plus its index.
+ * @param environments - the batch of environments
+ * @param seed - the seed of the first environment
+ * @param observations - an observation per environment
+ */
+void resetEnvironments(Environments* environments, const uint32_t seed,
+                       Observation* observations);
+
+/**
+ * Holds the keys of each action down for the given number of frames on
+ * every environment.
+ * @param environments - the batch of environments
+ * @param actions - the keypad state per environment, one bit per key
+ * @param frames - the number of frames to run
+ * @param observations - an observation per environment
+ */
+void stepEnvironments(Environments* environments, const uint16_t* actions,
+                      const uint32_t frames, Observation* observations);
+
+/**
+ * Captures the machine state of an environment.
+ * @param environments - the batch of environments
+ * @param index - the environment
+ * @param state - ENV_STATE_SIZE bytes to capture the state into
+ */
+void cloneEnvironment(const Environments* environments, const uint32_t index,
+                      uint8_t* state);
+
+/**
+ * Restores the machine state of an environment from a state captured by
+ * cloneEnvironment in the same batch or one running the same rom.
+ * @param environments - the batch of environments
+ * @param index - the environment
+ * @param state - ENV_STATE_SIZE bytes of captured state
+ * @param observation - the observation of the environment
+ */
+void restoreEnvironment(Environments* environments, const uint32_t index,
+                        const uint8_t* state, Observation* observation);
+
+/**
+ * Frees the batch of environments.
+ * @param environments - the batch of environments
+ */
+void destroyEnvironments(Environments* environments);
@@ -0,0 +1,74 @@
+#include "fault.h"
+
+// std
+#include <string.h>
+
+const char *faultName(const FaultKind kind) {
+  static const char *names[FAULT_COUNT] = {
+      [FAULT_NONE] = "none",
+      [FAULT_OPCODE] = "unknown instruction",
+      [FAULT_STACK_OVERFLOW] = "stack overflow",
+      [FAULT_STACK_UNDERFLOW] = "stack underflow",
+      [FAULT_RAM] = "access past ram",
+      [FAULT_KEY] = "key out of range",
+  };
+
+  return names[kind];
+}
+
+void initFaultLog(FaultLog *log, FILE *stream, const uint32_t rate) {
+  memset(log, 0, sizeof(*log));
+  log->stream = stream;
+  log->rate = rate;
+}
+
+// Remembers the fault, false if it was seen before. Once every key is
+// taken new faults count as seen
+static bool firstSeen(FaultLog *log, const Fault *fault) {
+  const uint32_t key = fault->kind << 28 | fault->address << 16 |
+                       fault->opcode;
+
+  for (uint32_t i = 0; i < log->keyCount; i++) {
+    if (log->keys[i] == key) return false;
+  }
+  if (log->keyCount == FAULT_LOG_KEYS) return false;
+
+  log->keys[log->keyCount++] = key;
+
+  return true;
+}
+
+void logFaults(FaultLog *log, const Chip8 *chip8) {
+  if (chip8->faultCount == log->faultCount) return;
+
+  const Fault *fault = &chip8->fault;
+  const uint32_t faults = chip8->faultCount - log->faultCount;
+  log->faultCount = chip8->faultCount;
+
+  const time_t now = time(NULL);
+  if (now != log->second) {
+    log->second = now;
+    log->lines = 0;
+  }
+
+  // A fault held back by the rate is not remembered, so it is written
+  // when it happens again
+  if (log->lines == log->rate || !firstSeen(log, fault)) {
+    log->suppressed += faults;
+    return;
+  }
+
+  log->lines++;
+  log->suppressed += faults - 1;
+  fprintf(log->stream, "Fault: %s at 0x%03X (%04X) on cycle %llu\n",
+          faultName(fault->kind), fault->address, fault->opcode,
+          (unsigned long long)fault->cycle);
+}
+
+void closeFaultLog(FaultLog *log) {
+  if (log->suppressed == 0) return;
+
+  fprintf(log->stream, "Faults: %llu more held back\n",
+          (unsigned long long)log->suppressed);
+  log->suppressed = 0;
+}
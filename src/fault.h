@@ -0,0 +1,58 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Distinct faults remembered, later ones are held back as repeats
+#define FAULT_LOG_KEYS 256
+
+// Lines a second written by default
+#define FAULT_LOG_RATE 10
+
+// Faults written to a stream, each distinct fault of an instruction once
+// and at most rate lines a second, counting the faults held back. A rom
+// stuck on garbage writes a line per address it runs through, not one per
+// instruction executed
+typedef struct {
+  FILE* stream;
+  uint32_t rate;
+  time_t second;
+  uint32_t lines;
+  uint32_t faultCount;
+  uint64_t suppressed;
+  uint32_t keys[FAULT_LOG_KEYS];
+  uint32_t keyCount;
+} FaultLog;
+
+/**
+ * Names the kind of fault.
+ * @param kind - the fault kind
+ * @return the name
+ */
+const char* faultName(const FaultKind kind);
+
+/**
+ * Initializes a fault log.
+ * @param log - the fault log
+ * @param stream - the stream to write to
+ * @param rate - the most lines written a second
+ */
+void initFaultLog(FaultLog* log, FILE* stream, const uint32_t rate);
+
+/**
+ * Writes the last fault of the emulator if it faulted since the previous
+ * call, unless the fault was written before or the rate is exceeded. Only
+ * the last fault is recorded, those before it count as held back.
+ * @param log - the fault log
+ * @param chip8 - the emulator state
+ */
+void logFaults(FaultLog* log, const Chip8* chip8);
+
+/**
+ * Writes the number of faults held back, if any.
+ * @param log - the fault log
+ */
+void closeFaultLog(FaultLog* log);
@@ -0,0 +1,212 @@
+#include "flowgraph.h"
+
+#include "disasm.h"
+// std
+#include <stdlib.h>
+#include <string.h>
+
+// Records a store of the block, I is NO_ADDRESS when not known statically
+static void recordWrite(BasicBlock *block, const uint16_t index,
+                        const uint16_t size) {
+  if (index == NO_ADDRESS) {
+    block->unknownWrite = true;
+    return;
+  }
+
+  const uint16_t end = index + size < RAM_SIZE ? index + size : RAM_SIZE;
+
+  // Stores touching a recorded range widen it, a loop storing to the same
+  // bytes keeps a single range
+  for (uint32_t i = 0; i < block->writeCount; i++) {
+    WriteRange *range = &block->writes[i];
+
+    if (index <= range->end && end >= range->start) {
+      if (index < range->start) range->start = index;
+      if (end > range->end) range->end = end;
+      return;
+    }
+  }
+
+  block->writes[block->writeCount++] = (WriteRange){index, end};
+}
+
+void decodeBlock(const uint8_t *ram, const uint16_t address,
+                 const uint8_t *flags, BasicBlock *block,
+                 WriteRange *writes) {
+  *block = (BasicBlock){
+      .start = address,
+      .end = address,
+      .successors = {NO_ADDRESS, NO_ADDRESS},
+      .target = NO_ADDRESS,
+      .exit = EXIT_INVALID,
+      .writes = writes,
+  };
+
+  // Index register as far as it is known within the block
+  uint16_t index = NO_ADDRESS;
+  uint16_t pc = address;
+
+  while (pc + 1 < RAM_SIZE) {
+    // Another block starts here
+    if (flags != NULL && pc != address && (flags[pc] & ADDRESS_LEADER)) {
+      block->exit = EXIT_FALLTHROUGH;
+      block->successors[0] = pc;
+      return;
+    }
+
+    const uint16_t opcode = ram[pc] << 8 | ram[pc + 1];
+    const uint16_t nnn = opcode & 0x0FFF;
+    const uint8_t x = (opcode >> 8) & 0x000F;
+
+    pc += 2;
+    block->end = pc;
+
+    switch (opcodeClass(opcode)) {
+      case OP_JP:
+        block->exit = nnn == pc - 2 ? EXIT_HALT : EXIT_JUMP;
+        block->successors[0] = nnn;
+        return;
+      case OP_CALL:
+        block->exit = EXIT_CALL;
+        block->target = nnn;
+        block->successors[0] = pc;
+        return;
+      case OP_RET:
+        block->exit = EXIT_RETURN;
+        return;
+      case OP_JP_V0:
+        block->exit = EXIT_INDIRECT;
+        block->target = nnn;
+        return;
+      case OP_SE_BYTE:
+      case OP_SNE_BYTE:
+      case OP_SE_REG:
+      case OP_SNE_REG:
+      case OP_SKP:
+      case OP_SKNP:
+        block->exit = EXIT_SKIP;
+        block->successors[0] = pc;
+        block->successors[1] = pc + 2;
+        return;
+      case OP_UNKNOWN:
+        block->exit = EXIT_INVALID;
+        return;
+      case OP_LD_I:
+        index = nnn;
+        break;
+      case OP_LD_BCD:
+        recordWrite(block, index, 3);
+        break;
+      case OP_STORE:
+        // Whether I advances depends on the quirk profile
+        recordWrite(block, index, x + 1);
+        index = NO_ADDRESS;
+        break;
+      case OP_ADD_I:
+      case OP_LD_FONT:
+      case OP_LOAD:
+        index = NO_ADDRESS;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+// Marks the address as a leader, queueing it the first time
+static void addLeader(ControlFlowGraph *graph, uint16_t *worklist,
+                      uint32_t *count, const uint16_t address) {
+  if (address >= RAM_SIZE || (graph->flags[address] & ADDRESS_LEADER)) {
+    return;
+  }
+
+  graph->flags[address] |= ADDRESS_LEADER;
+  worklist[(*count)++] = address;
+}
+
+// Marks the instructions, loads and stores of a reachable block
+static void markBlock(ControlFlowGraph *graph, const uint8_t *ram,
+                      const BasicBlock *block) {
+  for (uint16_t pc = block->start; pc < block->end; pc += 2) {
+    const uint16_t opcode = ram[pc] << 8 | ram[pc + 1];
+
+    graph->flags[pc] |= ADDRESS_CODE;
+    graph->flags[pc + 1] |= ADDRESS_OPERAND;
+
+    if (opcodeClass(opcode) == OP_LD_I) {
+      graph->flags[opcode & 0x0FFF] |= ADDRESS_LOADED;
+    }
+  }
+
+  for (uint32_t i = 0; i < block->writeCount; i++) {
+    for (uint16_t j = block->writes[i].start; j < block->writes[i].end; j++) {
+      graph->flags[j] |= ADDRESS_WRITTEN;
+    }
+  }
+}
+
+void analyzeRom(ControlFlowGraph *graph, const uint8_t *ram) {
+  // Leaders are queued once, so the worklist never holds more than ram
+  static uint16_t worklist[RAM_SIZE];
+  static WriteRange writes[RAM_SIZE / 2];
+  uint32_t count = 0;
+
+  memset(graph->flags, 0, sizeof(graph->flags));
+  graph->blockCount = 0;
+  graph->writeCount = 0;
+
+  addLeader(graph, worklist, &count, PROGRAM_START);
+  graph->flags[PROGRAM_START] |= ADDRESS_FUNCTION;
+
+  // Find every reachable instruction and where blocks start
+  while (count) {
+    BasicBlock block;
+    decodeBlock(ram, worklist[--count], NULL, &block, writes);
+    markBlock(graph, ram, &block);
+
+    for (uint32_t i = 0; i < 2; i++) {
+      addLeader(graph, worklist, &count, block.successors[i]);
+    }
+
+    if (block.exit == EXIT_CALL) {
+      addLeader(graph, worklist, &count, block.target);
+      graph->flags[block.target] |= ADDRESS_FUNCTION;
+    }
+  }
+
+  // Split the reachable code at every leader. An instruction is in one
+  // block at most, so the blocks' stores fit in the graph
+  for (uint32_t address = 0; address < RAM_SIZE; address++) {
+    if (!(graph->flags[address] & ADDRESS_CODE) ||
+        !(graph->flags[address] & ADDRESS_LEADER)) {
+      continue;
+    }
+
+    BasicBlock *block = &graph->blocks[graph->blockCount++];
+    decodeBlock(ram, address, graph->flags, block,
+                &graph->writes[graph->writeCount]);
+    graph->writeCount += block->writeCount;
+
+    for (uint32_t i = 0; i < block->writeCount; i++) {
+      if (writesCode(graph, &block->writes[i])) block->selfModifying = true;
+    }
+  }
+}
+
+bool writesCode(const ControlFlowGraph *graph, const WriteRange *range) {
+  for (uint32_t i = range->start; i < range->end; i++) {
+    if (graph->flags[i] & (ADDRESS_CODE | ADDRESS_OPERAND)) return true;
+  }
+
+  return false;
+}
+
+static int32_t compareBlocks(const void *address, const void *block) {
+  return *(const uint16_t *)address - ((const BasicBlock *)block)->start;
+}
+
+const BasicBlock *findBlock(const ControlFlowGraph *graph,
+                            const uint16_t address) {
+  return bsearch(&address, graph->blocks, graph->blockCount,
+                 sizeof(BasicBlock), compareBlocks);
+}
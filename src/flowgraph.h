@@ -0,0 +1,107 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+
+// No successor, target or known index register
+#define NO_ADDRESS 0xFFFF
+
+// Every address could start a block, instructions need not be aligned
+#define MAX_BLOCKS RAM_SIZE
+
+// Store ranges of a graph, at most one per instruction
+#define MAX_WRITES RAM_SIZE
+
+// What the analysis found at each byte of ram
+enum {
+  ADDRESS_CODE = 1 << 0,      // First byte of a reachable instruction
+  ADDRESS_OPERAND = 1 << 1,   // Second byte of a reachable instruction
+  ADDRESS_LEADER = 1 << 2,    // First instruction of a basic block
+  ADDRESS_FUNCTION = 1 << 3,  // Entry point or call target
+  ADDRESS_LOADED = 1 << 4,    // Loaded into I by ANNN
+  ADDRESS_WRITTEN = 1 << 5,   // Stored to by FX33 or FX55
+};
+
+// Bytes stored to by FX33 or FX55
+typedef struct {
+  uint16_t start;
+  uint16_t end;
+} WriteRange;
+
+// How a basic block ends
+typedef enum {
+  EXIT_FALLTHROUGH = 0,  // Runs into the next leader
+  EXIT_JUMP,             // 1NNN
+  EXIT_CALL,             // 2NNN, returning to the next instruction
+  EXIT_RETURN,           // 00EE
+  EXIT_SKIP,             // Skip instruction with two successors
+  EXIT_INDIRECT,         // BNNN, the target depends on a register
+  EXIT_HALT,             // 1NNN jumping to itself
+  EXIT_INVALID,          // Unknown opcode or the end of ram
+} BlockExit;
+
+// Straight-line run of instructions with a single entry
+typedef struct {
+  uint16_t start;
+  uint16_t end;  // Address after the last instruction
+  uint16_t successors[2];
+  uint16_t target;  // Call target or BNNN base address
+  BlockExit exit;
+  // Stores with I loaded by ANNN within the block, touching ranges merged
+  WriteRange* writes;
+  uint32_t writeCount;
+  bool unknownWrite;   // Stores with I computed at run time
+  bool selfModifying;  // Stores into reachable code
+} BasicBlock;
+
+// Recursive traversal of a rom from its entry point
+typedef struct {
+  uint8_t flags[RAM_SIZE];
+  BasicBlock blocks[MAX_BLOCKS];
+  uint32_t blockCount;
+  WriteRange writes[MAX_WRITES];
+  uint32_t writeCount;
+} ControlFlowGraph;
+
+/**
+ * Decodes the basic block starting at the address. On its own it runs
+ * until the first control flow instruction, as a block cache or
+ * recompiler front end would. With flags it also ends before any other
+ * leader.
+ * @param ram - the memory to decode
+ * @param address - the first instruction of the block
+ * @param flags - the analysis flags, or NULL
+ * @param block - the decoded block
+ * @param writes - room for a store range per instruction of the block,
+ * RAM_SIZE / 2 holds any
+ */
+void decodeBlock(const uint8_t* ram, const uint16_t address,
+                 const uint8_t* flags, BasicBlock* block,
+                 WriteRange* writes);
+
+/**
+ * Follows every jump, call, return and skip from PROGRAM_START and splits
+ * the reachable code into basic blocks in address order.
+ * @param graph - the control flow graph
+ * @param ram - the memory with the rom loaded
+ */
+void analyzeRom(ControlFlowGraph* graph, const uint8_t* ram);
+
+/**
+ * Tells whether a store range overlaps reachable code.
+ * @param graph - the control flow graph
+ * @param range - the store range
+ * @return true if any byte of the range is part of an instruction
+ */
+bool writesCode(const ControlFlowGraph* graph, const WriteRange* range);
+
+/**
+ * Finds the basic block starting at the address.
+ * @param graph - the control flow graph
+ * @param address - the first instruction of the block
+ * @return the block, NULL if no block starts there
+ */
+const BasicBlock* findBlock(const ControlFlowGraph* graph,
+                            const uint16_t address);
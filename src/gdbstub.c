@@ -0,0 +1,523 @@
+#include "gdbstub.h"
+
+#include "debugger.h"
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Registers in the order gdb numbers them: V0-VF, I, PC, SP, DT and ST
+#define GDB_REGISTERS (NUM_REGISTERS + 5)
+#define GDB_INDEX NUM_REGISTERS
+#define GDB_PC (NUM_REGISTERS + 1)
+#define GDB_SP (NUM_REGISTERS + 2)
+#define GDB_DT (NUM_REGISTERS + 3)
+#define GDB_ST (NUM_REGISTERS + 4)
+
+// Signals reported in stop replies
+#define GDB_SIGINT 2
+#define GDB_SIGTRAP 5
+
+// Register layout, gdb has no built in chip8 architecture
+#define GDB_REGISTER(name, bits, type) \
+  "<reg name=\"" name "\" bitsize=\"" #bits "\" type=\"" type "\"/>"
+static const char targetXml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\"><feature name=\"org.chip8.core\">"
+    GDB_REGISTER("v0", 8, "uint8") GDB_REGISTER("v1", 8, "uint8")
+    GDB_REGISTER("v2", 8, "uint8") GDB_REGISTER("v3", 8, "uint8")
+    GDB_REGISTER("v4", 8, "uint8") GDB_REGISTER("v5", 8, "uint8")
+    GDB_REGISTER("v6", 8, "uint8") GDB_REGISTER("v7", 8, "uint8")
+    GDB_REGISTER("v8", 8, "uint8") GDB_REGISTER("v9", 8, "uint8")
+    GDB_REGISTER("va", 8, "uint8") GDB_REGISTER("vb", 8, "uint8")
+    GDB_REGISTER("vc", 8, "uint8") GDB_REGISTER("vd", 8, "uint8")
+    GDB_REGISTER("ve", 8, "uint8") GDB_REGISTER("vf", 8, "uint8")
+    GDB_REGISTER("i", 16, "data_ptr") GDB_REGISTER("pc", 16, "code_ptr")
+    GDB_REGISTER("sp", 8, "uint8") GDB_REGISTER("dt", 8, "uint8")
+    GDB_REGISTER("st", 8, "uint8")
+    "</feature></target>";
+
+// Parses two hex digits, returning -1 if they are not
+static int32_t hexByte(const char *text) {
+  char digits[3] = {text[0], text[0] ? text[1] : '\0', '\0'};
+  char *end;
+  const int32_t value = strtol(digits, &end, 16);
+
+  return end == digits + 2 ? value : -1;
+}
+
+static uint32_t registerSize(const uint32_t number) {
+  return number == GDB_INDEX || number == GDB_PC ? 2 : 1;
+}
+
+static uint16_t readRegister(const Chip8 *chip8, const uint32_t number) {
+  if (number < NUM_REGISTERS) return chip8->V[number];
+
+  switch (number) {
+    case GDB_INDEX:
+      return chip8->indexRegister;
+    case GDB_PC:
+      return chip8->programCounter;
+    case GDB_SP:
+      return chip8->stackPointer;
+    case GDB_DT:
+      return chip8->delayTimer;
+    default:
+      return chip8->soundTimer;
+  }
+}
+
+static void writeRegister(Chip8 *chip8, const uint32_t number,
+                          const uint16_t value) {
+  if (number < NUM_REGISTERS) {
+    chip8->V[number] = value;
+    return;
+  }
+
+  // The program counter and stack pointer wrap like the interpreter does
+  switch (number) {
+    case GDB_INDEX:
+      chip8->indexRegister = value;
+      break;
+    case GDB_PC:
+      chip8->programCounter = value & (RAM_SIZE - 1);
+      break;
+    case GDB_SP:
+      chip8->stackPointer = value & (STACK_SIZE - 1);
+      break;
+    case GDB_DT:
+      chip8->delayTimer = value;
+      break;
+    default:
+      chip8->soundTimer = value;
+      break;
+  }
+}
+
+// Appends the register in target byte order, least significant first
+static char *encodeRegister(const Chip8 *chip8, const uint32_t number,
+                            char *reply) {
+  const uint16_t value = readRegister(chip8, number);
+
+  for (uint32_t i = 0; i < registerSize(number); i++) {
+    reply += sprintf(reply, "%02x", (value >> (i * 8)) & 0xFF);
+  }
+
+  return reply;
+}
+
+// Parses a register in target byte order, returning the text after it
+static const char *decodeRegister(Chip8 *chip8, const uint32_t number,
+                                  const char *text) {
+  uint16_t value = 0;
+
+  for (uint32_t i = 0; i < registerSize(number); i++, text += 2) {
+    const int32_t byte = hexByte(text);
+    if (byte < 0) return NULL;
+    value |= byte << (i * 8);
+  }
+
+  writeRegister(chip8, number, value);
+
+  return text;
+}
+
+// Parses "address,length" and checks the range is within ram
+static const char *parseRange(const char *text, uint32_t *address,
+                              uint32_t *length) {
+  char *end;
+  *address = strtoul(text, &end, 16);
+  if (*end != ',') return NULL;
+  *length = strtoul(end + 1, &end, 16);
+
+  return *address + *length <= RAM_SIZE ? end : NULL;
+}
+
+// Sends a packet with its checksum, a disconnected gdb is ignored
+static void sendPacket(const GdbStub *stub, const char *data) {
+  static char frame[GDB_PACKET_SIZE + 4];
+  uint8_t checksum = 0;
+
+  for (const char *c = data; *c; c++) checksum += *c;
+
+  const int32_t size =
+      snprintf(frame, sizeof(frame), "$%s#%02x", data, checksum);
+  send(stub->client, frame, size, MSG_NOSIGNAL);
+}
+
+static void stopReply(const Chip8 *chip8, char *reply) {
+  const Debugger *debugger = chip8->debugger;
+
+  switch (debugger->stopReason) {
+    case STOP_WATCHPOINT:
+      sprintf(reply, "T%02xwatch:%x;", GDB_SIGTRAP, debugger->stopAddress);
+      break;
+    case STOP_INTERRUPT:
+      sprintf(reply, "S%02x", GDB_SIGINT);
+      break;
+    default:
+      sprintf(reply, "S%02x", GDB_SIGTRAP);
+      break;
+  }
+}
+
+// Continues or single steps, the stop is reported once the emulator stops
+static void resume(GdbStub *stub, Chip8 *chip8, const char *address,
+                   const bool step) {
+  if (*address) {
+    chip8->programCounter = strtoul(address, NULL, 16) % RAM_SIZE;
+  }
+
+  if (step) {
+    stepExecution(chip8);
+  } else {
+    resumeExecution(chip8);
+  }
+
+  chip8->state = RUNNING;
+  stub->running = true;
+}
+
+// Handles Z and z, software and hardware breakpoints both use the bitmap
+// so ram is never patched, write watchpoints cover every byte written
+static bool updatePoint(Chip8 *chip8, const char *text, const bool enabled) {
+  char *end;
+  const uint32_t type = strtoul(text, &end, 16);
+  if (*end != ',') return false;
+  const uint32_t address = strtoul(end + 1, &end, 16);
+  if (*end != ',') return false;
+  const uint32_t length = strtoul(end + 1, NULL, 16);
+
+  if (type <= 1 && address < RAM_SIZE) {
+    setBreakpoint(chip8, address, enabled);
+    return true;
+  }
+
+  if (type == 2 && address + length <= RAM_SIZE) {
+    for (uint32_t i = 0; i < length; i++) {
+      setWatchpoint(chip8, address + i, enabled);
+    }
+    return true;
+  }
+
+  return false;
+}
+
+// Handles qXfer:features:read:target.xml:offset,length
+static void readTargetXml(const char *text, char *reply) {
+  char *end;
+  const uint32_t offset = strtoul(text, &end, 16);
+  const uint32_t length = strtoul(end + 1, NULL, 16);
+  const uint32_t size = sizeof(targetXml) - 1;
+
+  if (offset >= size) {
+    strcpy(reply, "l");
+    return;
+  }
+
+  // Leave room for the marker and the terminator
+  uint32_t count = size - offset;
+  if (count > length) count = length;
+  if (count > GDB_PACKET_SIZE - 2) count = GDB_PACKET_SIZE - 2;
+
+  reply[0] = offset + count < size ? 'm' : 'l';
+  memcpy(&reply[1], &targetXml[offset], count);
+  reply[count + 1] = '\0';
+}
+
+// Handles a packet, returning false if it has no reply
+static bool handlePacket(GdbStub *stub, Chip8 *chip8) {
+  const char *packet = stub->packet;
+  char *reply = stub->reply;
+  uint32_t address, length, number;
+  const char *end;
+  char *next;
+
+  reply[0] = '\0';
+
+  switch (packet[0]) {
+    case '?':
+      stopReply(chip8, reply);
+      break;
+    case 'g':
+      for (uint32_t i = 0; i < GDB_REGISTERS; i++) {
+        reply = encodeRegister(chip8, i, reply);
+      }
+      break;
+    case 'G':
+      end = &packet[1];
+      for (uint32_t i = 0; i < GDB_REGISTERS && end != NULL; i++) {
+        end = decodeRegister(chip8, i, end);
+      }
+      strcpy(reply, end != NULL ? "OK" : "E01");
+      break;
+    case 'p':
+      number = strtoul(&packet[1], NULL, 16);
+      if (number < GDB_REGISTERS) {
+        encodeRegister(chip8, number, reply);
+      } else {
+        strcpy(reply, "E01");
+      }
+      break;
+    case 'P':
+      number = strtoul(&packet[1], &next, 16);
+      if (number < GDB_REGISTERS && *next == '=' &&
+          decodeRegister(chip8, number, next + 1) != NULL) {
+        strcpy(reply, "OK");
+      } else {
+        strcpy(reply, "E01");
+      }
+      break;
+    case 'm':
+      if (parseRange(&packet[1], &address, &length) == NULL ||
+          length * 2 >= GDB_PACKET_SIZE) {
+        strcpy(reply, "E01");
+        break;
+      }
+      for (uint32_t i = 0; i < length; i++) {
+        reply += sprintf(reply, "%02x", chip8->ram[address + i]);
+      }
+      break;
+    case 'M':
+      end = parseRange(&packet[1], &address, &length);
+      if (end == NULL || *end++ != ':' || strlen(end) != length * 2) {
+        strcpy(reply, "E01");
+        break;
+      }
+      for (number = 0; number < length; number++) {
+        const int32_t byte = hexByte(&end[number * 2]);
+        if (byte < 0) break;
+        chip8->ram[address + number] = byte;
+        chip8->dirtyPages |= 1u << (address + number) / DIRTY_PAGE_SIZE;
+      }
+      strcpy(reply, number == length ? "OK" : "E01");
+      break;
+    case 'c':
+      resume(stub, chip8, &packet[1], false);
+      return false;
+    case 's':
+      resume(stub, chip8, &packet[1], true);
+      return false;
+    case 'Z':
+    case 'z':
+      strcpy(reply, updatePoint(chip8, &packet[1], packet[0] == 'Z') ? "OK"
+                                                                      : "");
+      break;
+    case 'H':
+      strcpy(reply, "OK");
+      break;
+    case 'D':
+      // Let the emulator run on without gdb, unless it was killed
+      strcpy(reply, "OK");
+      resumeExecution(chip8);
+      if (chip8->state != QUIT) chip8->state = RUNNING;
+      stub->running = false;
+      break;
+    case 'k':
+      chip8->state = QUIT;
+      return false;
+    case 'q':
+      if (strncmp(packet, "qSupported", 10) == 0) {
+        sprintf(reply, "PacketSize=%x;qXfer:features:read+",
+                GDB_PACKET_SIZE - 1);
+      } else if (strncmp(packet, "qXfer:features:read:target.xml:", 31) ==
+                 0) {
+        readTargetXml(&packet[31], reply);
+      } else if (strcmp(packet, "qAttached") == 0) {
+        strcpy(reply, "1");
+      }
+      break;
+  }
+
+  return true;
+}
+
+void serviceGdbStub(GdbStub *stub, Chip8 *chip8) {
+  const bool stopped = stub->running && stopReason(chip8) != STOP_NONE;
+
+  // A single load per frame while gdb is idle
+  if (!stopped && !__atomic_load_n(&stub->pending, __ATOMIC_ACQUIRE) &&
+      !__atomic_load_n(&stub->interrupt, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+
+  pthread_mutex_lock(&stub->lock);
+
+  // Ctrl-C or a new connection stops the emulator
+  if (stub->interrupt) {
+    stub->interrupt = false;
+    interruptExecution(chip8);
+    chip8->state = PAUSED;
+  }
+
+  if (stub->pending) {
+    if (handlePacket(stub, chip8)) sendPacket(stub, stub->reply);
+    __atomic_store_n(&stub->pending, false, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&stub->serviced);
+  }
+
+  // Report the stop of a continue or step
+  if (stub->running && stopReason(chip8) != STOP_NONE) {
+    stub->running = false;
+    stopReply(chip8, stub->reply);
+    sendPacket(stub, stub->reply);
+  }
+
+  pthread_mutex_unlock(&stub->lock);
+}
+
+// Hands a packet to the emulator thread and waits until it is serviced
+static void postPacket(GdbStub *stub, const char *packet) {
+  pthread_mutex_lock(&stub->lock);
+
+  strcpy(stub->packet, packet);
+  __atomic_store_n(&stub->pending, true, __ATOMIC_RELEASE);
+
+  while (stub->pending && !stub->quit) {
+    pthread_cond_wait(&stub->serviced, &stub->lock);
+  }
+
+  pthread_mutex_unlock(&stub->lock);
+}
+
+// Reads packets until gdb disconnects, acknowledging each one
+static void receivePackets(GdbStub *stub, const int32_t client) {
+  enum { IDLE, DATA, CHECKSUM_HIGH, CHECKSUM_LOW } state = IDLE;
+  char packet[GDB_PACKET_SIZE];
+  char checksum[2] = {0};
+  uint32_t length = 0;
+  uint8_t sum = 0;
+  char chunk[GDB_PACKET_SIZE];
+  ssize_t size;
+
+  while ((size = recv(client, chunk, sizeof(chunk), 0)) > 0) {
+    for (ssize_t i = 0; i < size; i++) {
+      const char c = chunk[i];
+
+      switch (state) {
+        case IDLE:
+          // Acknowledgements are ignored, 0x03 is Ctrl-C
+          if (c == '$') {
+            state = DATA;
+            length = 0;
+            sum = 0;
+          } else if (c == 0x03) {
+            __atomic_store_n(&stub->interrupt, true, __ATOMIC_RELEASE);
+          }
+          break;
+        case DATA:
+          if (c == '#') {
+            state = CHECKSUM_HIGH;
+          } else if (length < sizeof(packet) - 1) {
+            packet[length++] = c;
+            sum += c;
+          } else {
+            // Too long, the checksum can no longer match
+            sum++;
+          }
+          break;
+        case CHECKSUM_HIGH:
+          checksum[0] = c;
+          state = CHECKSUM_LOW;
+          break;
+        case CHECKSUM_LOW:
+          checksum[1] = c;
+          state = IDLE;
+          packet[length] = '\0';
+
+          if (hexByte(checksum) != sum) {
+            send(client, "-", 1, MSG_NOSIGNAL);
+            break;
+          }
+
+          send(client, "+", 1, MSG_NOSIGNAL);
+          postPacket(stub, packet);
+          if (__atomic_load_n(&stub->quit, __ATOMIC_ACQUIRE)) return;
+          break;
+      }
+    }
+  }
+}
+
+static void *serveGdb(void *arg) {
+  GdbStub *stub = arg;
+  int32_t client;
+
+  while ((client = accept(stub->server, NULL, NULL)) >= 0) {
+    pthread_mutex_lock(&stub->lock);
+    stub->client = client;
+    __atomic_store_n(&stub->interrupt, true, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&stub->lock);
+
+    receivePackets(stub, client);
+
+    // Detach so a disconnected gdb doesn't leave the emulator stopped
+    if (!__atomic_load_n(&stub->quit, __ATOMIC_ACQUIRE)) {
+      postPacket(stub, "D");
+    }
+
+    pthread_mutex_lock(&stub->lock);
+    stub->client = -1;
+    pthread_mutex_unlock(&stub->lock);
+    close(client);
+  }
+
+  return NULL;
+}
+
+bool startGdbStub(GdbStub *stub, const char *path) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    return false;
+  }
+  strcpy(address.sun_path, path);
+
+  // Replace a socket left behind by an earlier session
+  struct stat status;
+  if (stat(path, &status) == 0 && S_ISSOCK(status.st_mode)) unlink(path);
+
+  stub->client = -1;
+  stub->server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (stub->server < 0 ||
+      bind(stub->server, (struct sockaddr *)&address, sizeof(address)) ||
+      listen(stub->server, 1)) {
+    fprintf(stderr, "Failed to listen on %s\n", path);
+    if (stub->server >= 0) close(stub->server);
+    return false;
+  }
+
+  pthread_mutex_init(&stub->lock, NULL);
+  pthread_cond_init(&stub->serviced, NULL);
+
+  if (pthread_create(&stub->thread, NULL, serveGdb, stub) != 0) {
+    fprintf(stderr, "Failed to start the gdb stub thread\n");
+    close(stub->server);
+    unlink(path);
+    return false;
+  }
+
+  return true;
+}
+
+void stopGdbStub(GdbStub *stub, const char *path) {
+  // Wake the stub thread wherever it waits
+  pthread_mutex_lock(&stub->lock);
+  stub->quit = true;
+  pthread_cond_broadcast(&stub->serviced);
+  if (stub->client >= 0) shutdown(stub->client, SHUT_RDWR);
+  pthread_mutex_unlock(&stub->lock);
+
+  shutdown(stub->server, SHUT_RDWR);
+  pthread_join(stub->thread, NULL);
+
+  close(stub->server);
+  unlink(path);
+  pthread_mutex_destroy(&stub->lock);
+  pthread_cond_destroy(&stub->serviced);
+}
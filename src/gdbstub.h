@@ -0,0 +1,53 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Largest packet exchanged with gdb, enough to write all of ram in hex
+#define GDB_PACKET_SIZE 0x2100
+
+// GDB remote serial protocol stub. The stub thread owns the socket and
+// hands every packet to the emulator thread, which services it between
+// frames so the core is only ever touched at an instruction boundary
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t serviced;
+  int32_t server;
+  int32_t client;
+  // Written by the stub thread, serviced by the emulator thread
+  bool pending;
+  bool interrupt;
+  bool quit;
+  // Emulator thread only
+  bool running;
+  bool noAck;
+  char packet[GDB_PACKET_SIZE];
+  char reply[GDB_PACKET_SIZE];
+} GdbStub;
+
+/**
+ * Listens for gdb on a Unix socket and starts the stub thread.
+ * @param stub - the stub
+ * @param path - the path of the socket
+ * @return true if the socket is listening, false otherwise
+ */
+bool startGdbStub(GdbStub* stub, const char* path);
+
+/**
+ * Services the pending packet or interrupt and reports a stop to gdb.
+ * Called by the emulator thread between frames, with a debugger attached.
+ * @param stub - the stub
+ * @param chip8 - the emulator state
+ */
+void serviceGdbStub(GdbStub* stub, Chip8* chip8);
+
+/**
+ * Disconnects gdb and joins the stub thread.
+ * @param stub - the stub
+ * @param path - the path of the socket to remove
+ */
+void stopGdbStub(GdbStub* stub, const char* path);
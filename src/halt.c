@@ -0,0 +1,106 @@
+#include "halt.h"
+
+// std
+#include <stddef.h>
+#include <string.h>
+
+// The cycle count only ever grows, every other byte of machine state is
+// compared for repeats
+#define AFTER_RAM (offsetof(Chip8, ram) + RAM_SIZE)
+#define AFTER_CYCLES (offsetof(Chip8, cycles) + sizeof(uint64_t))
+
+static bool sameState(const uint8_t *state, const uint8_t *tortoise) {
+  return memcmp(&state[AFTER_RAM], &tortoise[AFTER_RAM],
+                offsetof(Chip8, cycles) - AFTER_RAM) == 0 &&
+         memcmp(&state[AFTER_CYCLES], &tortoise[AFTER_CYCLES],
+                CHIP8_STATE_SIZE - AFTER_CYCLES) == 0 &&
+         memcmp(&state[offsetof(Chip8, V)], &tortoise[offsetof(Chip8, V)],
+                AFTER_RAM - offsetof(Chip8, V)) == 0 &&
+         memcmp(state, tortoise, offsetof(Chip8, V)) == 0;
+}
+
+// Instruction at the program counter which already ran once and leaves
+// everything but the timers and the cycle count as it was
+static Halt stationaryHalt(const Chip8 *chip8) {
+  const uint16_t address = chip8->programCounter & (RAM_SIZE - 1);
+  const uint16_t opcode = (chip8->ram[address] << 8) |
+                          chip8->ram[(address + 1) & (RAM_SIZE - 1)];
+
+  if (chip8->programCounter != address || chip8->instruction.raw != opcode) {
+    return HALT_NONE;
+  }
+
+  if ((opcode & 0xF000) == 0x1000 && (opcode & 0x0FFF) == address) {
+    return HALT_JUMP;
+  }
+
+  // Without a key down nothing is pressed, and a key held down is never
+  // released
+  if ((opcode & 0xF0FF) == 0xF00A &&
+      (chip8->waitKey == NO_KEY ? keypadState(chip8) == 0
+                                : chip8->keypad[chip8->waitKey])) {
+    return HALT_KEY_WAIT;
+  }
+
+  return HALT_NONE;
+}
+
+void resetHaltDetector(HaltDetector *detector) {
+  detector->halt = HALT_NONE;
+  detector->period = 0;
+  detector->power = 0;
+  detector->length = 0;
+}
+
+Halt detectHalt(HaltDetector *detector, const Chip8 *chip8) {
+  detector->halt = stationaryHalt(chip8);
+  if (detector->halt != HALT_NONE) return detector->halt;
+
+  const uint8_t *state = (const uint8_t *)chip8;
+
+  // The first repeat is a whole period after the tortoise
+  if (detector->power && sameState(state, detector->tortoise)) {
+    detector->halt = HALT_CYCLE;
+    detector->period = detector->length;
+    detector->periodFaults = chip8->faultCount - detector->tortoiseFaults;
+    return detector->halt;
+  }
+
+  if (detector->length == detector->power) {
+    memcpy(detector->tortoise, state, CHIP8_STATE_SIZE);
+    detector->tortoiseFaults = chip8->faultCount;
+    detector->power = detector->power ? detector->power * 2 : 1;
+    detector->length = 0;
+  }
+  detector->length++;
+
+  return HALT_NONE;
+}
+
+uint32_t skipHaltedFrames(Chip8 *chip8, const HaltDetector *detector,
+                          const uint32_t frames, const uint32_t instructions) {
+  if (detector->halt == HALT_NONE) return frames;
+
+  const uint32_t left =
+      detector->halt == HALT_CYCLE ? frames % detector->period : 0;
+  const uint32_t skipped = frames - left;
+
+  chip8->cycles += (uint64_t)skipped * instructions;
+
+  // Timers of a cycle are part of the state repeating, a jump or key wait
+  // raises no faults
+  if (detector->halt == HALT_CYCLE) {
+    // The last fault recurs as many periods later
+    if (detector->periodFaults) {
+      chip8->faultCount += skipped / detector->period * detector->periodFaults;
+      chip8->fault.cycle += (uint64_t)skipped * instructions;
+    }
+  } else {
+    chip8->delayTimer =
+        chip8->delayTimer > skipped ? chip8->delayTimer - skipped : 0;
+    chip8->soundTimer =
+        chip8->soundTimer > skipped ? chip8->soundTimer - skipped : 0;
+  }
+
+  return left;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+
+// Ways a run can end up where its output can no longer change
+typedef enum {
+  HALT_NONE = 0,
+  // 0x1NNN jumping to itself
+  HALT_JUMP,
+  // 0xFX0A waiting for a key press or release the keypad will never give
+  HALT_KEY_WAIT,
+  // Machine state repeating every period frames
+  HALT_CYCLE,
+} Halt;
+
+// Brent's cycle detection over the machine state between frames, valid
+// once the keypad no longer changes. The tortoise is the state at the last
+// power of two frames, compared against every later frame, registers
+// first so frames that differ are told apart in a few bytes
+typedef struct {
+  Halt halt;
+  uint32_t period;
+  uint32_t power;
+  uint32_t length;
+  // Faults raised by then, to count those of a period
+  uint32_t tortoiseFaults;
+  uint32_t periodFaults;
+  uint8_t tortoise[CHIP8_STATE_SIZE];
+} HaltDetector;
+
+/**
+ * Starts detection over, as is needed whenever the keypad changes.
+ * @param detector - the halt detector
+ */
+void resetHaltDetector(HaltDetector* detector);
+
+/**
+ * Checks the emulator after a frame for a halt, a jump to itself or a key
+ * wait, and for the state repeating since an earlier frame.
+ * @param detector - the halt detector
+ * @param chip8 - the emulator state
+ * @return the halt found, HALT_NONE while the run may still change
+ */
+Halt detectHalt(HaltDetector* detector, const Chip8* chip8);
+
+/**
+ * Skips frames after a halt, leaving the emulator as running them would:
+ * timers run down, cycles and faults counted. A cycle is skipped a whole
+ * number of periods at a time.
+ * @param chip8 - the emulator state
+ * @param detector - the halt detector that found the halt
+ * @param frames - the number of frames to skip
+ * @param instructions - the number of instructions per frame
+ * @return the number of frames still to run, fewer than a period
+ */
+uint32_t skipHaltedFrames(Chip8* chip8, const HaltDetector* detector,
+                          const uint32_t frames, const uint32_t instructions);
@@ -0,0 +1,132 @@
+#include "image.h"
+
+#include "state.h"
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+RomImage *loadRomImage(const char *filePath) {
+  FILE *rom = fopen(filePath, "rb");
+
+  if (rom == NULL) {
+    fprintf(stderr, "Failed to open ROM file: %s\n", filePath);
+    return NULL;
+  }
+
+  RomImage *image = calloc(1, sizeof(*image));
+  if (image == NULL) {
+    fclose(rom);
+    return NULL;
+  }
+
+  // Reading one byte past the largest rom tells a rom that is too large
+  const size_t size = fread(image->data, 1, sizeof(image->data), rom);
+  const bool tooLarge = size == sizeof(image->data) && fgetc(rom) != EOF;
+  fclose(rom);
+
+  if (tooLarge) {
+    fprintf(stderr, "ROM file too large: %s\n", filePath);
+    free(image);
+    return NULL;
+  }
+
+  // The power on state is built once in a scratch emulator and pinned
+  Chip8 *chip8 = calloc(1, sizeof(*chip8));
+  if (chip8 == NULL) {
+    free(image);
+    return NULL;
+  }
+  resetChip8(chip8);
+  loadRomData(chip8, image->data, size);
+  pinBranch(&image->powerOn, image->pages, chip8);
+  free(chip8);
+
+  atomic_init(&image->references, 1);
+  image->path = strdup(filePath);
+  image->size = size;
+  romFingerprint(image->data, size, image->fingerprint);
+
+  return image;
+}
+
+RomImage *retainRomImage(RomImage *image) {
+  atomic_fetch_add_explicit(&image->references, 1, memory_order_relaxed);
+  return image;
+}
+
+void releaseRomImage(RomImage *image) {
+  if (image == NULL ||
+      atomic_fetch_sub_explicit(&image->references, 1,
+                                memory_order_acq_rel) != 1) {
+    return;
+  }
+
+  free(image->path);
+  free(image);
+}
+
+void powerOnRomImage(Chip8 *chip8, const RomImage *image,
+                     const RomImage *loaded) {
+  // Only the quirk profile survives, as with resetChip8
+  const Profile profile = chip8->profile;
+  checkoutBranch(chip8, &image->powerOn,
+                 loaded != NULL ? &loaded->powerOn : NULL);
+  setProfile(chip8, profile);
+
+  chip8->fault = (Fault){0};
+  chip8->faultCount = 0;
+}
+
+// Open addressing over a power of two table, kept at most half full
+static RomImage **findSlot(const RomImageCache *cache, const char *filePath) {
+  const uint32_t mask = cache->capacity - 1;
+  uint32_t slot = checksum(filePath, strlen(filePath)) & mask;
+
+  while (cache->slots[slot] != NULL &&
+         strcmp(cache->slots[slot]->path, filePath) != 0) {
+    slot = (slot + 1) & mask;
+  }
+
+  return &cache->slots[slot];
+}
+
+static bool growCache(RomImageCache *cache) {
+  RomImageCache grown = {
+      .capacity = cache->capacity ? cache->capacity * 2 : 64,
+      .count = cache->count,
+  };
+  grown.slots = calloc(grown.capacity, sizeof(RomImage *));
+  if (grown.slots == NULL) return false;
+
+  for (uint32_t i = 0; i < cache->capacity; i++) {
+    if (cache->slots[i] == NULL) continue;
+    *findSlot(&grown, cache->slots[i]->path) = cache->slots[i];
+  }
+
+  free(cache->slots);
+  *cache = grown;
+
+  return true;
+}
+
+RomImage *cachedRomImage(RomImageCache *cache, const char *filePath) {
+  if (cache->count * 2 >= cache->capacity && !growCache(cache)) return NULL;
+
+  RomImage **slot = findSlot(cache, filePath);
+  if (*slot != NULL) return *slot;
+
+  *slot = loadRomImage(filePath);
+  if (*slot != NULL) cache->count++;
+
+  return *slot;
+}
+
+void destroyRomImageCache(RomImageCache *cache) {
+  for (uint32_t i = 0; i < cache->capacity; i++) {
+    releaseRomImage(cache->slots[i]);
+  }
+
+  free(cache->slots);
+  *cache = (RomImageCache){0};
+}
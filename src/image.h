@@ -0,0 +1,81 @@
+#pragma once
+
+#include "branch.h"
+#include "core.h"
+#include "romdb.h"
+// std
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Rom read from disk and fingerprinted once, along with the power on state
+// it loads into. The state's pages are pinned and read-only, so every
+// instance running the rom, in any pool or thread, shares them and holds
+// copies of the pages it writes only. Reference counts are atomic, so
+// images can be handed between threads
+typedef struct {
+  atomic_uint references;
+  char* path;
+  uint16_t size;
+  char fingerprint[SHA1_SIZE * 2 + 1];
+  uint8_t data[RAM_SIZE - PROGRAM_START];
+  // Power on state with the rom loaded, clone it to start a branch
+  Branch powerOn;
+  BranchPage pages[BRANCH_PAGES];
+} RomImage;
+
+// Images by path, each read from disk at most once
+typedef struct {
+  RomImage** slots;
+  uint32_t capacity;
+  uint32_t count;
+} RomImageCache;
+
+/**
+ * Reads a rom into a new image holding a single reference.
+ * @param filePath - the path to the rom
+ * @return the image, or NULL if the rom could not be read
+ */
+RomImage* loadRomImage(const char* filePath);
+
+/**
+ * Takes a reference to an image.
+ * @param image - the image
+ * @return the image
+ */
+RomImage* retainRomImage(RomImage* image);
+
+/**
+ * Drops a reference to an image, freeing it with the last one.
+ * @param image - the image, or NULL
+ */
+void releaseRomImage(RomImage* image);
+
+/**
+ * Powers the emulator on with the rom of an image, as resetChip8 and loadRom
+ * would without touching the disk. Only the pages that differ from the
+ * image are copied, so powering on again from the same image copies just
+ * the pages written since.
+ * @param chip8 - the emulator state
+ * @param image - the image
+ * @param loaded - the image the emulator was last powered on from, with no
+ * branch snapshotted or checked out since, or NULL to copy every page
+ */
+void powerOnRomImage(Chip8* chip8, const RomImage* image,
+                     const RomImage* loaded);
+
+/**
+ * Looks up the image of a rom, reading it on the first request. The cache
+ * holds a reference to every image it returns, holders outliving the cache
+ * take their own.
+ * @param cache - the image cache
+ * @param filePath - the path to the rom
+ * @return the image, or NULL if the rom could not be read
+ */
+RomImage* cachedRomImage(RomImageCache* cache, const char* filePath);
+
+/**
+ * Drops the cache's references to its images.
+ * @param cache - the image cache
+ */
+void destroyRomImageCache(RomImageCache* cache);
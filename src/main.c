@@ -0,0 +1,267 @@
+#include "chip8.h"
+#include "debugger.h"
+#include "fault.h"
+#include "gdbstub.h"
+#include "movie.h"
+#include "profiler.h"
+#include "rewind.h"
+#include "romdb.h"
+#include "trace.h"
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  // Default configuration
+  Config config = {0};
+  defaultConfig(&config);
+
+  // Parse the command line options
+  const char *usage =
+      "Usage: chip8 [-i] [-q] [-p vip|chip48|schip|xochip|modern] "
+      "[-r movie] [-P movie] [-t trace] [-b address] [-w address] "
+      "[-g socket] <rom>\n";
+  static Debugger debugger;
+  uint16_t breakpoints[MAX_DEBUG_POINTS];
+  uint16_t watchpoints[MAX_DEBUG_POINTS];
+  uint32_t breakpointCount = 0;
+  uint32_t watchpointCount = 0;
+  const char *gdbPath = NULL;
+  const char *profileName = NULL;
+  const char *recordPath = NULL;
+  const char *replayPath = NULL;
+  bool identify = false;
+  bool quiet = false;
+  int32_t option;
+
+  while ((option = getopt(argc, argv, "iqp:r:P:t:b:w:g:")) != -1) {
+    switch (option) {
+      case 'i':
+        identify = true;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      case 'p':
+        profileName = optarg;
+        break;
+      case 'r':
+        recordPath = optarg;
+        break;
+      case 'P':
+        replayPath = optarg;
+        break;
+      case 't':
+        config.tracePath = optarg;
+        break;
+      case 'b':
+        if (breakpointCount == MAX_DEBUG_POINTS ||
+            !parseAddress(optarg, &breakpoints[breakpointCount++])) {
+          fprintf(stderr, "Invalid breakpoint: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'w':
+        if (watchpointCount == MAX_DEBUG_POINTS ||
+            !parseAddress(optarg, &watchpoints[watchpointCount++])) {
+          fprintf(stderr, "Invalid watchpoint: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'g':
+        gdbPath = optarg;
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 1) {
+    fprintf(stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+
+  // Print the rom database entry for the rom and exit
+  if (identify) {
+    static Chip8 rom;
+    if (!loadRom(&rom, argv[optind])) {
+      return EXIT_FAILURE;
+    }
+
+    char fingerprint[SHA1_SIZE * 2 + 1];
+    romFingerprint(&rom.ram[PROGRAM_START], rom.romSize, fingerprint);
+    printf("ROM(\"%s\", PROFILE_MODERN, %u, 0x%08X, 0x%08X, \"%s\")\n",
+           fingerprint, config.instructionsPerSecond, config.foregroundColor,
+           config.backgroundColor, argv[optind]);
+    return EXIT_SUCCESS;
+  }
+
+  // Replay the movie without a window or pacing and exit
+  if (replayPath != NULL) {
+    return replayHeadless(replayPath, argv[optind], config.tracePath)
+               ? EXIT_SUCCESS
+               : EXIT_FAILURE;
+  }
+
+  // Initialize SDL and Chip8
+  Sdl sdl = {0};
+  Chip8 chip8 = {0};
+
+  if (!initSdl(&sdl, &config) || !initChip8(&chip8, &config)) {
+    return EXIT_FAILURE;
+  }
+
+  // Load the ROM
+  if (!loadRom(&chip8, argv[optind])) {
+    return EXIT_FAILURE;
+  }
+  config.romName = argv[optind];
+
+  // Use the tuned settings if the rom is a known one
+  const RomInfo *info = findRom(&chip8.ram[PROGRAM_START], chip8.romSize);
+  if (info != NULL) {
+    applyRomInfo(&config, info);
+  }
+
+  // An explicitly requested profile overrides the rom database
+  if (profileName != NULL && !parseProfile(profileName, &config.profile)) {
+    fprintf(stderr, "Unknown profile: %s\n", profileName);
+    return EXIT_FAILURE;
+  }
+
+  // Select the interpreter once the rom is known
+  setProfile(&chip8, config.profile);
+
+  // Seed the random number generator
+  const uint32_t seed = time(NULL);
+  seedRandom(&chip8, seed);
+
+  // Keep a trace of the most recent instructions, flushed on a crash
+  static Trace trace;
+  if (config.tracePath != NULL) {
+    chip8.trace = &trace;
+    flushTraceOnCrash(&trace, config.tracePath);
+  }
+
+  // Stop on the requested breakpoints and watchpoints
+  if (breakpointCount || watchpointCount || gdbPath != NULL) {
+    attachDebugger(&chip8, &debugger);
+    for (uint32_t i = 0; i < breakpointCount; i++) {
+      setBreakpoint(&chip8, breakpoints[i], true);
+    }
+    for (uint32_t i = 0; i < watchpointCount; i++) {
+      setWatchpoint(&chip8, watchpoints[i], true);
+    }
+  }
+
+  // Serve gdb from its own thread
+  static GdbStub stub;
+  if (gdbPath != NULL && !startGdbStub(&stub, gdbPath)) {
+    return EXIT_FAILURE;
+  }
+
+  // Record the keypad from power on
+  Movie movie;
+  if (recordPath != NULL) {
+    startMovie(&movie, &chip8, &config, seed);
+  }
+
+  // Every frame is captured so it can be rewound
+  Rewind rewind;
+  if (!initRewind(&rewind, config.rewindBufferSize, config.rewindFrames)) {
+    fprintf(stderr, "Failed to allocate the rewind buffer\n");
+    return EXIT_FAILURE;
+  }
+
+  // Faults go to stderr without flooding it
+  FaultLog faultLog;
+  initFaultLog(&faultLog, stderr, FAULT_LOG_RATE);
+
+  while (chip8.state != QUIT) {
+    // Poll and handle input events
+    handleInput(&chip8, &config, recordPath != NULL ? &movie : NULL);
+
+    if (recordPath != NULL) {
+      recordInput(&movie, &chip8);
+    }
+
+    // Let gdb inspect and control the emulator between frames
+    if (gdbPath != NULL) {
+      serviceGdbStub(&stub, &chip8);
+    }
+
+    // Skip if the emulator is paused
+    if (chip8.state == PAUSED) continue;
+
+    const uint64_t beginFrame = SDL_GetTicks();
+
+    if (chip8.state == REWINDING) {
+      // The recording ends at the state before the first rewound frame
+      if (recordPath != NULL && !movie.ended) {
+        endMovie(&movie, &chip8);
+        fprintf(stderr, "Recording ended, rewinds are not recorded\n");
+      }
+
+      // Step back a frame instead of executing instructions
+      if (rewindFrame(&rewind, &chip8)) chip8.draw = true;
+    } else {
+      // Uniformly execute instructions per frame and decrement the delay
+      // and sound timers at the rate of 60Hz. Replays run the same frame,
+      // so the timers tick even when input quits
+      runFrame(&chip8, config.instructionsPerSecond / FRAME_RATE);
+
+      // Capture the finished frame
+      captureFrame(&rewind, &chip8);
+
+      if (!quiet) logFaults(&faultLog, &chip8);
+
+      // Pause where the debugger stopped
+      if (chip8.state == RUNNING && stopReason(&chip8) != STOP_NONE) {
+        fprintf(stderr, "Stopped on %s at 0x%03X\n",
+                stopReasonName(stopReason(&chip8)), debugger.stopAddress);
+        chip8.state = PAUSED;
+      }
+    }
+
+    const uint64_t endFrame = SDL_GetTicks();
+
+    // Delay if finished early to maintain a constant frame rate
+    SDL_Delay(FRAME_DURATION_IN_MS - (beginFrame - endFrame));
+
+    // Update the screen and play audio
+    draw(&sdl, &chip8, &config);
+    sound(&chip8, &sdl);
+  }
+
+#ifdef CHIP8_PROFILER
+  // Write the profile of the session next to the rom
+  char profilePath[FILENAME_MAX];
+  snprintf(profilePath, sizeof(profilePath), "%s.profile", config.romName);
+  writeProfile(&chip8, profilePath);
+#endif
+
+  // Write out the trace and the recording
+  if (config.tracePath != NULL) {
+    flushTrace(&trace, config.tracePath);
+  }
+
+  if (recordPath != NULL) {
+    saveMovie(&movie, &chip8, recordPath);
+    destroyMovie(&movie);
+  }
+
+  if (gdbPath != NULL) {
+    stopGdbStub(&stub, gdbPath);
+  }
+
+  closeFaultLog(&faultLog);
+
+  // Cleanup SDL and Chip8
+  destroyRewind(&rewind);
+  cleanup(&sdl);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#include "manifest.h"
+
+// std
+#include <stdlib.h>
+#include <string.h>
+
+#define FIELD_SEPARATORS " \t\r\n"
+
+bool openManifest(Manifest *manifest, const char *path) {
+  *manifest = (Manifest){0};
+  manifest->file = fopen(path, "r");
+
+  if (manifest->file == NULL) {
+    fprintf(stderr, "Failed to open manifest: %s\n", path);
+    return false;
+  }
+
+  return true;
+}
+
+char *nextManifestLine(Manifest *manifest) {
+  while (fgets(manifest->line, sizeof(manifest->line), manifest->file) !=
+         NULL) {
+    manifest->lineNumber++;
+
+    char *comment = strchr(manifest->line, '#');
+    if (comment != NULL) *comment = '\0';
+
+    char *field =
+        strtok_r(manifest->line, FIELD_SEPARATORS, &manifest->save);
+    if (field != NULL) return field;
+  }
+
+  return NULL;
+}
+
+char *nextManifestField(Manifest *manifest) {
+  return strtok_r(NULL, FIELD_SEPARATORS, &manifest->save);
+}
+
+void closeManifest(Manifest *manifest) {
+  if (manifest->file != NULL) fclose(manifest->file);
+  manifest->file = NULL;
+}
+
+bool parseKeyEvents(const char *text, KeyEvent *events,
+                    const uint32_t capacity, uint32_t *count) {
+  *count = 0;
+  if (strcmp(text, "-") == 0) return true;
+
+  char copy[MANIFEST_LINE_SIZE];
+  snprintf(copy, sizeof(copy), "%s", text);
+
+  char *save;
+  for (char *token = strtok_r(copy, ",", &save); token;
+       token = strtok_r(NULL, ",", &save)) {
+    const char *colon = strchr(token, ':');
+    if (*count == capacity || colon == NULL) return false;
+
+    KeyEvent *event = &events[(*count)++];
+    event->frame = strtoul(token, NULL, 10);
+    event->keys = strtoul(colon + 1, NULL, 16);
+
+    if (*count > 1 && event->frame <= event[-1].frame) return false;
+  }
+
+  return true;
+}
+
+void applyKeyEvents(Chip8 *chip8, const KeyEvent *events,
+                    const uint32_t count, const uint32_t frame,
+                    uint32_t *next) {
+  while (*next < count && events[*next].frame <= frame) {
+    setKeypadState(chip8, events[(*next)++].keys);
+  }
+}
+
+bool writeFrame(const char *path, const uint8_t *frame) {
+  FILE *file = fopen(path, "w");
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open frame file: %s\n", path);
+    return false;
+  }
+
+  fprintf(file, "P1\n%u %u\n", WINDOW_WIDTH, WINDOW_HEIGHT);
+
+  for (uint32_t i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; i++) {
+    fputc(frame[i] ? '1' : '0', file);
+    fputc((i + 1) % WINDOW_WIDTH ? ' ' : '\n', file);
+  }
+
+  fclose(file);
+
+  return true;
+}
+
+bool readFrame(const char *path, uint8_t *frame) {
+  FILE *file = fopen(path, "r");
+  uint32_t width;
+  uint32_t height;
+
+  if (file == NULL) return false;
+
+  bool valid = fscanf(file, "P1 %u %u", &width, &height) == 2 &&
+               width == WINDOW_WIDTH && height == WINDOW_HEIGHT;
+
+  for (uint32_t i = 0; valid && i < WINDOW_WIDTH * WINDOW_HEIGHT; i++) {
+    uint32_t pixel;
+    valid = fscanf(file, "%1u", &pixel) == 1;
+    frame[i] = pixel;
+  }
+
+  fclose(file);
+
+  return valid;
+}
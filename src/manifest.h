@@ -0,0 +1,98 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Longest line of a manifest or request
+#define MANIFEST_LINE_SIZE 1024
+
+// Keypad state applied before the given frame
+typedef struct {
+  uint32_t frame;
+  uint16_t keys;
+} KeyEvent;
+
+// Manifest read a line at a time. Lines are fields separated by whitespace,
+// # starts a comment and lines without fields are skipped
+typedef struct {
+  FILE* file;
+  char line[MANIFEST_LINE_SIZE];
+  uint32_t lineNumber;
+  char* save;
+} Manifest;
+
+/**
+ * Opens a manifest for reading.
+ * @param manifest - the manifest
+ * @param path - the path to the manifest
+ * @return true if the manifest was opened, false otherwise
+ */
+bool openManifest(Manifest* manifest, const char* path);
+
+/**
+ * Reads up to the next line with fields, whose number is then in
+ * lineNumber. The fields point into the line and are overwritten by the next.
+ * @param manifest - the manifest
+ * @return the first field of the line, or NULL at the end of the manifest
+ */
+char* nextManifestLine(Manifest* manifest);
+
+/**
+ * Takes the next field of the current line.
+ * @param manifest - the manifest
+ * @return the field, or NULL if the line has no more
+ */
+char* nextManifestField(Manifest* manifest);
+
+/**
+ * Closes a manifest.
+ * @param manifest - the manifest
+ */
+void closeManifest(Manifest* manifest);
+
+/**
+ * Parses keypad input written as frame:keys pairs separated by commas, or -
+ * for none. The keypad bits are hexadecimal and apply from that frame on,
+ * and frames only move forward.
+ * @param text - the input
+ * @param events - the events to fill in
+ * @param capacity - the number of events there is room for
+ * @param count - set to the number of events parsed
+ * @return true if the input is valid and fits, false otherwise
+ */
+bool parseKeyEvents(const char* text, KeyEvent* events,
+                    const uint32_t capacity, uint32_t* count);
+
+/**
+ * Sets the keypad state of the events due by a frame. Frames count from 1,
+ * so events at frame 0 and 1 both apply before the first.
+ * @param chip8 - the emulator state
+ * @param events - the parsed events
+ * @param count - the number of events
+ * @param frame - the frame about to run
+ * @param next - the first event not yet applied, advanced past the ones
+ * applied
+ */
+void applyKeyEvents(Chip8* chip8, const KeyEvent* events,
+                    const uint32_t count, const uint32_t frame,
+                    uint32_t* next);
+
+/**
+ * Writes a framebuffer as a plain PBM image.
+ * @param path - the path to the image
+ * @param frame - WINDOW_WIDTH * WINDOW_HEIGHT pixels
+ * @return true if the image was written, false otherwise
+ */
+bool writeFrame(const char* path, const uint8_t* frame);
+
+/**
+ * Reads a framebuffer written by writeFrame.
+ * @param path - the path to the image
+ * @param frame - WINDOW_WIDTH * WINDOW_HEIGHT pixels to fill in
+ * @return true if the image was read, false if there is none or it is not
+ * a framebuffer
+ */
+bool readFrame(const char* path, uint8_t* frame);
@@ -0,0 +1,161 @@
+#include "movie.h"
+
+#include "state.h"
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void startMovie(Movie *movie, const Chip8 *chip8, const Config *config,
+                const uint32_t seed) {
+  *movie = (Movie){0};
+
+  movie->header.magic = MOVIE_MAGIC;
+  movie->header.version = MOVIE_VERSION;
+  movie->header.profile = chip8->profile;
+  movie->header.instructionsPerSecond = config->instructionsPerSecond;
+  movie->header.seed = seed;
+
+  romFingerprint(&chip8->ram[PROGRAM_START], chip8->romSize,
+                 movie->header.fingerprint);
+}
+
+void recordInput(Movie *movie, const Chip8 *chip8) {
+  MovieHeader *header = &movie->header;
+  if (movie->ended) return;
+
+  const uint16_t keys = keypadState(chip8);
+  const uint16_t last =
+      header->eventCount ? movie->events[header->eventCount - 1].keys : 0;
+
+  if (keys == last) return;
+
+  // Grow the event log geometrically
+  if (header->eventCount == movie->capacity) {
+    const uint32_t capacity = movie->capacity ? movie->capacity * 2 : 256;
+    MovieEvent *events =
+        realloc(movie->events, capacity * sizeof(*movie->events));
+
+    if (events == NULL) {
+      fprintf(stderr, "Failed to record input\n");
+      return;
+    }
+
+    movie->events = events;
+    movie->capacity = capacity;
+  }
+
+  movie->events[header->eventCount++] =
+      (MovieEvent){.cycle = chip8->cycles, .keys = keys};
+}
+
+void endMovie(Movie *movie, const Chip8 *chip8) {
+  if (movie->ended) return;
+
+  // The final state lets replays verify they are bit exact
+  movie->header.cycles = chip8->cycles;
+  movie->header.checksum = checksum(chip8, CHIP8_STATE_SIZE);
+  movie->ended = true;
+}
+
+bool saveMovie(Movie *movie, const Chip8 *chip8, const char *filePath) {
+  FILE *file = fopen(filePath, "wb");
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open movie file: %s\n", filePath);
+    return false;
+  }
+
+  endMovie(movie, chip8);
+
+  const uint32_t count = movie->header.eventCount;
+  const bool written =
+      fwrite(&movie->header, sizeof(movie->header), 1, file) == 1 &&
+      fwrite(movie->events, sizeof(*movie->events), count, file) == count;
+  fclose(file);
+
+  if (!written) {
+    fprintf(stderr, "Failed to write movie file: %s\n", filePath);
+  }
+
+  return written;
+}
+
+bool loadMovie(Movie *movie, const char *filePath) {
+  FILE *file = fopen(filePath, "rb");
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open movie file: %s\n", filePath);
+    return false;
+  }
+
+  *movie = (Movie){0};
+
+  // Replays run whole frames, without an instruction per frame they never
+  // reach the recorded cycle
+  if (fread(&movie->header, sizeof(movie->header), 1, file) != 1 ||
+      movie->header.magic != MOVIE_MAGIC ||
+      movie->header.version != MOVIE_VERSION ||
+      movie->header.profile >= PROFILE_COUNT ||
+      movie->header.instructionsPerSecond < FRAME_RATE) {
+    fprintf(stderr, "Invalid movie file: %s\n", filePath);
+    fclose(file);
+    return false;
+  }
+
+  const uint32_t count = movie->header.eventCount;
+  movie->events = malloc(count * sizeof(*movie->events));
+  movie->capacity = count;
+
+  if (count && (movie->events == NULL ||
+                fread(movie->events, sizeof(*movie->events), count, file) !=
+                    count)) {
+    fprintf(stderr, "Failed to read movie file: %s\n", filePath);
+    fclose(file);
+    destroyMovie(movie);
+    return false;
+  }
+
+  fclose(file);
+
+  return true;
+}
+
+bool replayMovie(const Movie *movie, Chip8 *chip8) {
+  const MovieHeader *header = &movie->header;
+
+  char fingerprint[SHA1_SIZE * 2 + 1];
+  romFingerprint(&chip8->ram[PROGRAM_START], chip8->romSize, fingerprint);
+
+  if (strcmp(fingerprint, header->fingerprint) != 0) {
+    fprintf(stderr, "Movie was recorded with a different rom\n");
+    return false;
+  }
+
+  // Start from the same power on state as the recording
+  setProfile(chip8, header->profile);
+  seedRandom(chip8, header->seed);
+
+  const uint32_t instructions = header->instructionsPerSecond / FRAME_RATE;
+  uint32_t next = 0;
+
+  while (chip8->cycles < header->cycles) {
+    // Apply the keypad changes made before this frame
+    while (next < header->eventCount &&
+           movie->events[next].cycle <= chip8->cycles) {
+      setKeypadState(chip8, movie->events[next++].keys);
+    }
+
+    runFrame(chip8, instructions);
+
+    // The frontend consumes the draw flag every frame
+    chip8->draw = false;
+  }
+
+  return checksum(chip8, CHIP8_STATE_SIZE) == header->checksum;
+}
+
+void destroyMovie(Movie *movie) {
+  free(movie->events);
+  *movie = (Movie){0};
+}
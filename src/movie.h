@@ -0,0 +1,98 @@
+#pragma once
+
+#include "core.h"
+#include "romdb.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MOVIE_MAGIC 0x564D3843  // "C8MV"
+#define MOVIE_VERSION 2
+
+// Keypad state from the given cycle onwards
+typedef struct {
+  uint64_t cycle;
+  uint16_t keys;
+} MovieEvent;
+
+// Everything needed to reproduce a session from power on
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t profile;
+  uint32_t instructionsPerSecond;
+  uint32_t seed;
+  uint64_t cycles;
+  uint32_t eventCount;
+  uint32_t checksum;
+  char fingerprint[SHA1_SIZE * 2 + 1];
+} MovieHeader;
+
+// Recorded session, the keypad changes are kept in memory until saved
+typedef struct {
+  MovieHeader header;
+  MovieEvent* events;
+  uint32_t capacity;
+  bool ended;  // No more input is recorded
+} Movie;
+
+/**
+ * Starts recording a session. Should be called once the rom is loaded,
+ * the profile selected and the random number generator seeded.
+ * @param movie - the movie
+ * @param chip8 - the emulator state
+ * @param config - the emulator configuration
+ * @param seed - the seed of the random number generator
+ */
+void startMovie(Movie* movie, const Chip8* chip8, const Config* config,
+                const uint32_t seed);
+
+/**
+ * Records the keypad if it changed since the last recorded event, unless
+ * the recording has ended.
+ * @param movie - the movie
+ * @param chip8 - the emulator state
+ */
+void recordInput(Movie* movie, const Chip8* chip8);
+
+/**
+ * Ends the recording at the current cycle, unless it has ended already.
+ * Loading a state or rewinding jumps to a state the input does not lead
+ * to, so the recording has to end before either.
+ * @param movie - the movie
+ * @param chip8 - the emulator state
+ */
+void endMovie(Movie* movie, const Chip8* chip8);
+
+/**
+ * Ends the recording at the current cycle, unless it has ended already, and
+ * writes it to a file.
+ * @param movie - the movie
+ * @param chip8 - the emulator state
+ * @param filePath - the path to the movie file
+ * @return true if saving was successful, false otherwise
+ */
+bool saveMovie(Movie* movie, const Chip8* chip8, const char* filePath);
+
+/**
+ * Reads a movie file.
+ * @param movie - the movie
+ * @param filePath - the path to the movie file
+ * @return true if loading was successful, false otherwise
+ */
+bool loadMovie(Movie* movie, const char* filePath);
+
+/**
+ * Replays the movie headless at full speed from a freshly loaded rom,
+ * frame by frame as the frontend ran it.
+ * @param movie - the movie
+ * @param chip8 - the emulator state
+ * @return true if the final state matches the recording, false otherwise
+ */
+bool replayMovie(const Movie* movie, Chip8* chip8);
+
+/**
+ * Frees the recorded events.
+ * @param movie - the movie
+ */
+void destroyMovie(Movie* movie);
@@ -0,0 +1,123 @@
+#include "pool.h"
+
+// std
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Explicit huge pages need to be reserved by the administrator, failing
+// that transparent huge pages are asked for and the kernel may or may not
+// back the arena with them
+static void *mapArena(const size_t size, bool *hugePages) {
+  void *arena = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  arena = mmap(NULL, size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+  *hugePages = arena != MAP_FAILED;
+  if (*hugePages) return arena;
+
+  arena = mmap(NULL, size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (arena == MAP_FAILED) return NULL;
+
+#ifdef MADV_HUGEPAGE
+  madvise(arena, size, MADV_HUGEPAGE);
+#endif
+
+  return arena;
+}
+
+bool initInstancePool(InstancePool *pool, const Chip8 *chip8,
+                      const uint32_t count) {
+  const size_t hotSize = (size_t)count * sizeof(HotBlock);
+  const size_t size =
+      (hotSize + (size_t)count * sizeof(Chip8) + HUGE_PAGE_SIZE - 1) /
+      HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+  memset(pool, 0, sizeof(*pool));
+  pool->arena = mapArena(size, &pool->hugePages);
+
+  if (pool->arena == NULL) {
+    fprintf(stderr, "Failed to map an arena for %u instances\n", count);
+    return false;
+  }
+
+  pool->arenaSize = size;
+  pool->count = count;
+  pool->hot = pool->arena;
+  pool->cold = (Chip8 *)((uint8_t *)pool->arena + hotSize);
+
+  for (uint32_t i = 0; i < count; i++) {
+    Chip8 *instance = &pool->cold[i];
+    memcpy(instance, chip8, CHIP8_STATE_SIZE);
+    instance->state = RUNNING;
+    setProfile(instance, chip8->profile);
+    checkinInstance(pool, i);
+  }
+
+  return true;
+}
+
+Chip8 *checkoutInstance(InstancePool *pool, const uint32_t index) {
+  const HotBlock *hot = &pool->hot[index];
+  Chip8 *instance = &pool->cold[index];
+
+  memcpy(instance->V, hot->V, NUM_REGISTERS);
+  instance->cycles = hot->cycles;
+  instance->state = hot->state;
+  instance->indexRegister = hot->indexRegister;
+  instance->programCounter = hot->programCounter;
+  setKeypadState(instance, hot->keys);
+  instance->stackPointer = hot->stackPointer;
+  instance->stackDepth = hot->stackDepth;
+  instance->delayTimer = hot->delayTimer;
+  instance->soundTimer = hot->soundTimer;
+  instance->waitKey = hot->waitKey;
+  instance->draw = hot->draw;
+
+  return instance;
+}
+
+void checkinInstance(InstancePool *pool, const uint32_t index) {
+  HotBlock *hot = &pool->hot[index];
+  const Chip8 *instance = &pool->cold[index];
+
+  memcpy(hot->V, instance->V, NUM_REGISTERS);
+  hot->cycles = instance->cycles;
+  hot->state = instance->state;
+  hot->indexRegister = instance->indexRegister;
+  hot->programCounter = instance->programCounter;
+  hot->keys = keypadState(instance);
+  hot->stackPointer = instance->stackPointer;
+  hot->stackDepth = instance->stackDepth;
+  hot->delayTimer = instance->delayTimer;
+  hot->soundTimer = instance->soundTimer;
+  hot->waitKey = instance->waitKey;
+  hot->draw = instance->draw;
+}
+
+uint32_t runInstances(InstancePool *pool, const uint32_t first,
+                      const uint32_t count, const uint32_t frames,
+                      const uint32_t instructions) {
+  uint32_t ran = 0;
+
+  for (uint32_t i = first; i < first + count; i++) {
+    if (pool->hot[i].state != RUNNING) continue;
+
+    Chip8 *instance = checkoutInstance(pool, i);
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      runFrame(instance, instructions);
+    }
+    checkinInstance(pool, i);
+    ran++;
+  }
+
+  return ran;
+}
+
+void destroyInstancePool(InstancePool *pool) {
+  if (pool->arena != NULL) munmap(pool->arena, pool->arenaSize);
+  memset(pool, 0, sizeof(*pool));
+}
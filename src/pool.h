@@ -0,0 +1,95 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_LINE 64
+
+// Arena sizes are rounded up to whole huge pages
+#define HUGE_PAGE_SIZE (2 << 20)
+
+// Registers and run state of an instance, packed into a cache line of
+// their own so loops over many instances touch one line per instance
+typedef struct {
+  _Alignas(CACHE_LINE) uint8_t V[NUM_REGISTERS];
+  uint64_t cycles;
+  State state;
+  uint16_t indexRegister;
+  uint16_t programCounter;
+  uint16_t keys;
+  uint8_t stackPointer;
+  uint8_t stackDepth;
+  uint8_t delayTimer;
+  uint8_t soundTimer;
+  uint8_t waitKey;
+  uint8_t draw;
+} HotBlock;
+
+_Static_assert(sizeof(HotBlock) == CACHE_LINE, "hot blocks fill a line");
+
+// Instances of any number of emulators carved out of a single arena backed
+// by huge pages where the system has them. The hot blocks come first, one
+// after another, then the rest of each instance: ram, framebuffer, stack
+// and host state. Between runs the hot block holds the current value of
+// its fields and the body copy of them is stale
+typedef struct {
+  HotBlock* hot;
+  Chip8* cold;
+  uint32_t count;
+  void* arena;
+  size_t arenaSize;
+  // Whether the arena got explicit huge pages, or was left to
+  // transparent huge pages
+  bool hugePages;
+} InstancePool;
+
+/**
+ * Allocates the arena and copies the machine state of the emulator, with
+ * the rom loaded and the profile selected, into every instance.
+ * @param pool - the instance pool
+ * @param chip8 - the emulator state to copy
+ * @param count - the number of instances
+ * @return true if the arena could be mapped, false otherwise
+ */
+bool initInstancePool(InstancePool* pool, const Chip8* chip8,
+                      const uint32_t count);
+
+/**
+ * Copies the hot block of an instance into its body, making the full state
+ * current for reading or writing.
+ * @param pool - the instance pool
+ * @param index - the instance
+ * @return the full state of the instance
+ */
+Chip8* checkoutInstance(InstancePool* pool, const uint32_t index);
+
+/**
+ * Copies the fields of the hot block back from the body of an instance
+ * after its full state was changed.
+ * @param pool - the instance pool
+ * @param index - the instance
+ */
+void checkinInstance(InstancePool* pool, const uint32_t index);
+
+/**
+ * Runs frames on every running instance in a range, as runFrame would.
+ * Instances whose hot block is in any other state are skipped.
+ * @param pool - the instance pool
+ * @param first - the first instance
+ * @param count - the number of instances
+ * @param frames - the number of frames to run on each
+ * @param instructions - the number of instructions per frame
+ * @return the number of instances run
+ */
+uint32_t runInstances(InstancePool* pool, const uint32_t first,
+                      const uint32_t count, const uint32_t frames,
+                      const uint32_t instructions);
+
+/**
+ * Unmaps the arena, after which no instance may be used.
+ * @param pool - the instance pool
+ */
+void destroyInstancePool(InstancePool* pool);
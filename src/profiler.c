@@ -0,0 +1,102 @@
+#include "profiler.h"
+// std
+#include <stdio.h>
+#include <stdlib.h>
+
+Profiler profiler;
+
+// Orders addresses by descending execution count
+static int32_t compareAddresses(const void *a, const void *b) {
+  const uint64_t countA = profiler.addresses[*(const uint16_t *)a];
+  const uint64_t countB = profiler.addresses[*(const uint16_t *)b];
+
+  return (countA < countB) - (countA > countB);
+}
+
+// Orders opcode classes by descending execution count
+static int32_t compareOpcodes(const void *a, const void *b) {
+  const uint64_t countA = profiler.opcodes[*(const uint8_t *)a];
+  const uint64_t countB = profiler.opcodes[*(const uint8_t *)b];
+
+  return (countA < countB) - (countA > countB);
+}
+
+// Reads the opcode at the address as the interpreter would fetch it
+static uint16_t opcodeAt(const Chip8 *chip8, const uint16_t address) {
+  return chip8->ram[address] << 8 | chip8->ram[(address + 1) % RAM_SIZE];
+}
+
+bool writeProfile(const Chip8 *chip8, const char *filePath) {
+  FILE *file = fopen(filePath, "w");
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open profile file: %s\n", filePath);
+    return false;
+  }
+
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < OP_COUNT; i++) total += profiler.opcodes[i];
+
+  // Guard the percentages against an empty profile
+  const double percent = total ? 100.0 / total : 0;
+  char mnemonic[32];
+
+  // Hottest addresses first
+  static uint16_t addresses[RAM_SIZE];
+  for (uint32_t i = 0; i < RAM_SIZE; i++) addresses[i] = i;
+  qsort(addresses, RAM_SIZE, sizeof(*addresses), compareAddresses);
+
+  fprintf(file, "Hot spots(%llu instructions)\n\n",
+          (unsigned long long)total);
+  for (uint32_t i = 0; i < PROFILE_HOT_SPOTS; i++) {
+    const uint16_t address = addresses[i];
+    if (!profiler.addresses[address]) break;
+
+    disassemble(opcodeAt(chip8, address), mnemonic, sizeof(mnemonic));
+    fprintf(file, "%03X  %-16s %12llu %6.2f%%\n", address, mnemonic,
+            (unsigned long long)profiler.addresses[address],
+            profiler.addresses[address] * percent);
+  }
+
+  // Opcode classes
+  uint8_t opcodes[OP_COUNT];
+  for (uint32_t i = 0; i < OP_COUNT; i++) opcodes[i] = i;
+  qsort(opcodes, OP_COUNT, sizeof(*opcodes), compareOpcodes);
+
+  fprintf(file, "\nOpcode classes\n\n");
+  for (uint32_t i = 0; i < OP_COUNT; i++) {
+    const uint8_t opcode = opcodes[i];
+    if (!profiler.opcodes[opcode]) break;
+
+    fprintf(file, "%-16s %12llu %6.2f%%\n", opcodeClassName(opcode),
+            (unsigned long long)profiler.opcodes[opcode],
+            profiler.opcodes[opcode] * percent);
+  }
+
+  // Disassembly of the rom, following executed instructions even when
+  // they are not aligned to the start of the rom
+  fprintf(file, "\nAnnotated disassembly\n\n");
+  const uint32_t end = PROGRAM_START + chip8->romSize;
+  for (uint32_t address = PROGRAM_START; address < end;) {
+    const uint64_t count = profiler.addresses[address];
+
+    if (!count && address + 1 < end && profiler.addresses[address + 1]) {
+      fprintf(file, "%03X  DB 0x%02X\n", address, chip8->ram[address]);
+      address++;
+      continue;
+    }
+
+    disassemble(opcodeAt(chip8, address), mnemonic, sizeof(mnemonic));
+    if (count) {
+      fprintf(file, "%03X  %-16s %12llu %6.2f%%\n", address, mnemonic,
+              (unsigned long long)count, count * percent);
+    } else {
+      fprintf(file, "%03X  %-16s\n", address, mnemonic);
+    }
+    address += 2;
+  }
+
+  fclose(file);
+
+  return true;
+}
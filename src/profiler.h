@@ -0,0 +1,42 @@
+#pragma once
+
+#include "core.h"
+#include "disasm.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hottest addresses listed in the profile report
+#define PROFILE_HOT_SPOTS 32
+
+// Execution counts, only collected when built with -DCHIP8_PROFILER
+typedef struct {
+  uint64_t addresses[RAM_SIZE];
+  uint64_t opcodes[OP_COUNT];
+} Profiler;
+
+extern Profiler profiler;
+
+#ifdef CHIP8_PROFILER
+#define PROFILE_INSTRUCTION(chip8) profileInstruction(chip8)
+#else
+#define PROFILE_INSTRUCTION(chip8)
+#endif
+
+/**
+ * Counts the fetched instruction against its address and opcode class.
+ * @param chip8 - the emulator state
+ */
+static inline void profileInstruction(const Chip8* chip8) {
+  profiler.addresses[(chip8->programCounter - 2) & (RAM_SIZE - 1)]++;
+  profiler.opcodes[opcodeClass(chip8->instruction.raw)]++;
+}
+
+/**
+ * Writes the hot spots, the opcode class counts and the disassembly of the
+ * rom annotated with the execution counts.
+ * @param chip8 - the emulator state
+ * @param filePath - the path to the report
+ * @return true if writing was successful, false otherwise
+ */
+bool writeProfile(const Chip8* chip8, const char* filePath);
@@ -0,0 +1,258 @@
+#include "rewind.h"
+// std
+#include <stdlib.h>
+#include <string.h>
+
+// Unchanged bytes needed to end a run of changed bytes, shorter gaps are
+// cheaper to store as changed bytes than as a new run
+#define REWIND_MIN_GAP 3
+
+// Index of the nth oldest frame in the frame ring
+static inline uint32_t frameIndex(const Rewind *rewind, const uint32_t n) {
+  return (rewind->first + n) % rewind->maxFrames;
+}
+
+// Appends a LEB128 encoded value
+static inline uint8_t *writeVarint(uint8_t *out, uint32_t value) {
+  while (value >= 0x80) {
+    *out++ = value | 0x80;
+    value >>= 7;
+  }
+  *out++ = value;
+
+  return out;
+}
+
+// Reads a LEB128 encoded value
+static inline const uint8_t *readVarint(const uint8_t *in, uint32_t *value) {
+  *value = 0;
+  for (uint32_t shift = 0;; shift += 7) {
+    *value |= (uint32_t)(*in & 0x7F) << shift;
+    if (!(*in++ & 0x80)) break;
+  }
+
+  return in;
+}
+
+// Reference of keyframes, encoding against it stores the whole state
+static const uint8_t emptyState[CHIP8_STATE_SIZE];
+
+// Run-length encodes the XOR of the machine state and the reference as
+// pairs of unchanged and changed byte counts, each followed by the changed
+// bytes. Returns the encoded size
+static size_t encodeDelta(const uint8_t *current, const uint8_t *reference,
+                          uint8_t *out) {
+  uint8_t *cursor = out;
+  size_t position = 0;
+  size_t i = 0;
+
+  while (i < CHIP8_STATE_SIZE) {
+    // Skip whole unchanged words once aligned
+    if (i % sizeof(uint64_t) == 0) {
+      for (; i + sizeof(uint64_t) <= CHIP8_STATE_SIZE;
+           i += sizeof(uint64_t)) {
+        uint64_t a, b;
+        memcpy(&a, &current[i], sizeof(a));
+        memcpy(&b, &reference[i], sizeof(b));
+        if (a != b) break;
+      }
+      if (i >= CHIP8_STATE_SIZE) break;
+    }
+
+    if (current[i] == reference[i]) {
+      i++;
+      continue;
+    }
+
+    // Extend the run of changed bytes until a long enough gap
+    const size_t start = i;
+    size_t end = i + 1;
+    for (i = end; i < CHIP8_STATE_SIZE && i - end < REWIND_MIN_GAP; i++) {
+      if (current[i] != reference[i]) end = i + 1;
+    }
+
+    cursor = writeVarint(cursor, start - position);
+    cursor = writeVarint(cursor, end - start);
+    for (size_t j = start; j < end; j++) {
+      *cursor++ = current[j] ^ reference[j];
+    }
+    position = end;
+  }
+
+  return cursor - out;
+}
+
+// XORs the encoded delta into the state. Returns false, leaving the state
+// partly changed, if a run reaches past the state or the delta
+static bool applyDelta(uint8_t *state, const uint8_t *in, const size_t size) {
+  const uint8_t *end = in + size;
+  size_t position = 0;
+
+  while (in < end) {
+    uint32_t skip, length;
+    in = readVarint(in, &skip);
+    in = readVarint(in, &length);
+    position += skip;
+
+    if (position + length > CHIP8_STATE_SIZE || length > end - in) {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < length; i++) {
+      state[position + i] ^= in[i];
+    }
+
+    in += length;
+    position += length;
+  }
+
+  return true;
+}
+
+// Drops the oldest frame along with the deltas that depend on it, so
+// the oldest frame kept is always a keyframe
+static void evictFrames(Rewind *rewind) {
+  do {
+    rewind->first = frameIndex(rewind, 1);
+    rewind->count--;
+  } while (rewind->count && !rewind->frames[rewind->first].keyframe);
+}
+
+// Finds room for a frame of the given size after the newest frame,
+// evicting the oldest frames it would overwrite. Returns its offset
+static size_t reserveFrame(Rewind *rewind, const size_t size) {
+  size_t head = 0;
+
+  if (rewind->count) {
+    const RewindFrame *newest =
+        &rewind->frames[frameIndex(rewind, rewind->count - 1)];
+    head = newest->offset + newest->size;
+  }
+
+  // Frames are never split, wrap around when the end is too close
+  const size_t newestEnd = head;
+  const bool wrapped = head + size > rewind->capacity;
+  if (wrapped) head = 0;
+
+  if (rewind->count == rewind->maxFrames) evictFrames(rewind);
+
+  // Frames follow each other from the oldest, wrapping around the buffer at
+  // most once, so those the new frame overlaps are the oldest ones. When it
+  // wraps, frames left between the newest and the end of the buffer are
+  // older than those it overlaps at the start and go first
+  while (rewind->count) {
+    const size_t oldest = rewind->frames[rewind->first].offset;
+    if ((oldest < head || oldest >= head + size) &&
+        !(wrapped && oldest >= newestEnd)) {
+      break;
+    }
+    evictFrames(rewind);
+  }
+
+  return head;
+}
+
+bool initRewind(Rewind *rewind, const size_t capacity,
+                const uint32_t maxFrames) {
+  *rewind = (Rewind){0};
+
+  rewind->capacity = capacity;
+  rewind->maxFrames = maxFrames;
+  rewind->buffer = malloc(capacity);
+  rewind->frames = malloc(maxFrames * sizeof(*rewind->frames));
+
+  rewind->previous = malloc(CHIP8_STATE_SIZE);
+  rewind->scratch = malloc(REWIND_SCRATCH_SIZE);
+
+  if (rewind->buffer == NULL || rewind->frames == NULL ||
+      rewind->previous == NULL || rewind->scratch == NULL) {
+    destroyRewind(rewind);
+    return false;
+  }
+
+  return true;
+}
+
+void captureFrame(Rewind *rewind, const Chip8 *chip8) {
+  const uint8_t *current = (const uint8_t *)chip8;
+  uint8_t *encoded = rewind->scratch;
+
+  bool keyframe = rewind->count == 0 ||
+                  rewind->sinceKeyframe + 1 >= REWIND_KEYFRAME_INTERVAL;
+
+  size_t size = encodeDelta(current, keyframe ? emptyState : rewind->previous,
+                            encoded);
+  size_t offset = reserveFrame(rewind, size);
+
+  // The frames before this delta were evicted, store a keyframe instead
+  if (rewind->count == 0 && !keyframe) {
+    keyframe = true;
+    size = encodeDelta(current, emptyState, encoded);
+    offset = reserveFrame(rewind, size);
+  }
+
+  memcpy(&rewind->buffer[offset], encoded, size);
+  rewind->frames[frameIndex(rewind, rewind->count++)] =
+      (RewindFrame){.offset = offset, .size = size, .keyframe = keyframe};
+  rewind->sinceKeyframe = keyframe ? 0 : rewind->sinceKeyframe + 1;
+
+  // Only the changed bytes of the previous frame need updating
+  if (keyframe) {
+    memcpy(rewind->previous, current, CHIP8_STATE_SIZE);
+  } else {
+    applyDelta(rewind->previous, encoded, size);
+  }
+}
+
+bool rewindFrame(Rewind *rewind, Chip8 *chip8) {
+  if (rewind->count < 2) return false;
+
+  const RewindFrame *newest =
+      &rewind->frames[frameIndex(rewind, rewind->count - 1)];
+
+  // Find the keyframe the frame before the newest depends on
+  uint32_t keyframe = rewind->count - 2;
+  while (!rewind->frames[frameIndex(rewind, keyframe)].keyframe) keyframe--;
+
+  bool valid = true;
+
+  if (!newest->keyframe) {
+    // Undo the newest delta
+    valid = applyDelta(rewind->previous, &rewind->buffer[newest->offset],
+                       newest->size);
+  } else {
+    // Replay the deltas after the previous keyframe
+    memset(rewind->previous, 0, CHIP8_STATE_SIZE);
+    for (uint32_t i = keyframe; valid && i < rewind->count - 1; i++) {
+      const RewindFrame *frame = &rewind->frames[frameIndex(rewind, i)];
+      valid = applyDelta(rewind->previous, &rewind->buffer[frame->offset],
+                         frame->size);
+    }
+  }
+
+  // A damaged frame leaves nothing to rewind to, the next capture starts
+  // over from a keyframe
+  if (!valid) {
+    rewind->count = 0;
+    return false;
+  }
+
+  rewind->count--;
+  rewind->sinceKeyframe = rewind->count - 1 - keyframe;
+
+  memcpy(chip8, rewind->previous, CHIP8_STATE_SIZE);
+  chip8->dirtyPages = ALL_DIRTY_PAGES;
+
+  // The interpreter is host state, reselect it for the restored profile
+  setProfile(chip8, chip8->profile);
+
+  return true;
+}
+
+void destroyRewind(Rewind *rewind) {
+  free(rewind->buffer);
+  free(rewind->frames);
+  free(rewind->previous);
+  free(rewind->scratch);
+  *rewind = (Rewind){0};
+}
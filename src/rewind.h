@@ -0,0 +1,69 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Frames between two keyframes
+#define REWIND_KEYFRAME_INTERVAL FRAME_RATE
+
+// Worst case size of an encoded frame, every changed byte is followed by
+// a gap and costs at most two single byte counts
+#define REWIND_SCRATCH_SIZE (CHIP8_STATE_SIZE * 2 + 8)
+
+// Location of a captured frame in the rewind buffer
+typedef struct {
+  uint32_t offset;
+  uint16_t size;
+  bool keyframe;
+} RewindFrame;
+
+// Ring buffer of run-length encoded frames. Keyframes hold the whole
+// machine state and the frames in between hold the XOR delta against the
+// frame before them
+typedef struct {
+  uint8_t* buffer;
+  size_t capacity;
+  RewindFrame* frames;
+  uint32_t maxFrames;
+  uint32_t first;
+  uint32_t count;
+  uint32_t sinceKeyframe;
+  uint8_t* previous;
+  uint8_t* scratch;
+} Rewind;
+
+/**
+ * Allocates the rewind buffer.
+ * @param rewind - the rewind buffer
+ * @param capacity - the size of the buffer in bytes
+ * @param maxFrames - the maximum number of frames kept
+ * @return true if allocation was successful, false otherwise
+ */
+bool initRewind(Rewind* rewind, const size_t capacity,
+                const uint32_t maxFrames);
+
+/**
+ * Captures the machine state as the newest frame, evicting the oldest
+ * frames when the buffer is full.
+ * @param rewind - the rewind buffer
+ * @param chip8 - the emulator state
+ */
+void captureFrame(Rewind* rewind, const Chip8* chip8);
+
+/**
+ * Drops the newest frame and restores the machine state of the frame
+ * before it.
+ * @param rewind - the rewind buffer
+ * @param chip8 - the emulator state
+ * @return true if a frame was restored, false if there is nothing left
+ */
+bool rewindFrame(Rewind* rewind, Chip8* chip8);
+
+/**
+ * Frees the rewind buffer.
+ * @param rewind - the rewind buffer
+ */
+void destroyRewind(Rewind* rewind);
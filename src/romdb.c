@@ -0,0 +1,176 @@
+#include "romdb.h"
+// std
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sorted by fingerprint, the sentinel is not part of the search
+static const RomInfo romDatabase[] = {
+#define ROM(hash, ...) {hash, __VA_ARGS__},
+#include "romdb.inc"
+#undef ROM
+    {.title = NULL}  // Sentinel
+};
+
+static const size_t romDatabaseSize =
+    sizeof(romDatabase) / sizeof(*romDatabase) - 1;
+
+// Rotates the 32-bit value left by the given number of bits
+static inline uint32_t rotateLeft(const uint32_t value, const uint32_t bits) {
+  return (value << bits) | (value >> (32 - bits));
+}
+
+// Compresses a single 64 byte block into the hash state
+static void sha1Block(uint32_t state[5], const uint8_t block[64]) {
+  uint32_t w[80];
+
+  // Expand the block into 80 big-endian words
+  for (uint32_t i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+           (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+  }
+  for (uint32_t i = 16; i < 80; i++) {
+    w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+           e = state[4];
+
+  for (uint32_t i = 0; i < 80; i++) {
+    uint32_t f, k;
+
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+
+    const uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = rotateLeft(b, 30);
+    b = a;
+    a = temp;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+}
+
+void sha1(const uint8_t *data, size_t size, uint8_t digest[SHA1_SIZE]) {
+  uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                       0xC3D2E1F0};
+
+  // Hash all the complete blocks
+  size_t offset = 0;
+  for (; offset + 64 <= size; offset += 64) {
+    sha1Block(state, &data[offset]);
+  }
+
+  // Pad the remaining bytes with a single 1 bit, zeros and the
+  // message length in bits
+  uint8_t tail[128] = {0};
+  const size_t remaining = size - offset;
+  memcpy(tail, &data[offset], remaining);
+  tail[remaining] = 0x80;
+
+  const size_t tailSize = remaining < 56 ? 64 : 128;
+  const uint64_t bits = (uint64_t)size * 8;
+  for (uint32_t i = 0; i < 8; i++) {
+    tail[tailSize - 1 - i] = bits >> (i * 8);
+  }
+
+  for (size_t i = 0; i < tailSize; i += 64) {
+    sha1Block(state, &tail[i]);
+  }
+
+  for (uint32_t i = 0; i < SHA1_SIZE; i++) {
+    digest[i] = state[i / 4] >> (24 - (i % 4) * 8);
+  }
+}
+
+void romFingerprint(const uint8_t *rom, size_t size,
+                    char hex[SHA1_SIZE * 2 + 1]) {
+  static const char digits[] = "0123456789abcdef";
+  uint8_t digest[SHA1_SIZE];
+
+  sha1(rom, size, digest);
+
+  for (uint32_t i = 0; i < SHA1_SIZE; i++) {
+    hex[i * 2] = digits[digest[i] >> 4];
+    hex[i * 2 + 1] = digits[digest[i] & 0xF];
+  }
+  hex[SHA1_SIZE * 2] = '\0';
+}
+
+// Orders a fingerprint against a database entry
+static int32_t compareFingerprint(const void *key, const void *entry) {
+  return memcmp(key, ((const RomInfo *)entry)->sha1, SHA1_SIZE * 2);
+}
+
+#ifndef NDEBUG
+// Known answers from FIPS 180-2, the last padded into a second block
+static const char *sha1Vectors[][2] = {
+    {"", "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+    {"abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+};
+
+// A broken digest misses every rom and an entry out of order is missed by
+// the binary search, neither of which shows up otherwise
+static bool romDatabaseValid(void) {
+  char fingerprint[SHA1_SIZE * 2 + 1];
+
+  for (size_t i = 0; i < sizeof(sha1Vectors) / sizeof(*sha1Vectors); i++) {
+    romFingerprint((const uint8_t *)sha1Vectors[i][0],
+                   strlen(sha1Vectors[i][0]), fingerprint);
+    if (strcmp(fingerprint, sha1Vectors[i][1]) != 0) return false;
+  }
+
+  for (size_t i = 1; i < romDatabaseSize; i++) {
+    if (compareFingerprint(romDatabase[i].sha1, &romDatabase[i - 1]) <= 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+#endif
+
+const RomInfo *findRom(const uint8_t *rom, size_t size) {
+#ifndef NDEBUG
+  // Checked on the first lookup only, rerunning it would cost more than
+  // the lookup it guards
+  static bool checked = false;
+  if (!checked) {
+    assert(romDatabaseValid());
+    checked = true;
+  }
+#endif
+
+  char fingerprint[SHA1_SIZE * 2 + 1];
+  romFingerprint(rom, size, fingerprint);
+
+  return bsearch(fingerprint, romDatabase, romDatabaseSize,
+                 sizeof(*romDatabase), compareFingerprint);
+}
+
+void applyRomInfo(Config *config, const RomInfo *info) {
+  config->profile = info->profile;
+  config->instructionsPerSecond = info->instructionsPerSecond;
+  config->foregroundColor = info->foregroundColor;
+  config->backgroundColor = info->backgroundColor;
+}
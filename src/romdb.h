@@ -0,0 +1,51 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA1_SIZE 20
+
+// Settings of a known rom
+typedef struct {
+  char sha1[SHA1_SIZE * 2 + 1];
+  Profile profile;
+  uint32_t instructionsPerSecond;
+  uint32_t foregroundColor;
+  uint32_t backgroundColor;
+  const char* title;
+} RomInfo;
+
+/**
+ * Computes the SHA-1 digest of the given data.
+ * @param data - the data to hash
+ * @param size - the size of the data in bytes
+ * @param digest - the resulting digest
+ */
+void sha1(const uint8_t* data, size_t size, uint8_t digest[SHA1_SIZE]);
+
+/**
+ * Formats the SHA-1 digest of the rom as a lowercase hex string.
+ * @param rom - the rom image
+ * @param size - the size of the rom in bytes
+ * @param hex - the resulting hex string
+ */
+void romFingerprint(const uint8_t* rom, size_t size,
+                    char hex[SHA1_SIZE * 2 + 1]);
+
+/**
+ * Looks up the rom in the embedded rom database with a binary search
+ * over the sorted fingerprints.
+ * @param rom - the rom image
+ * @param size - the size of the rom in bytes
+ * @return the settings of the rom, NULL if the rom is unknown
+ */
+const RomInfo* findRom(const uint8_t* rom, size_t size);
+
+/**
+ * Applies the settings of a known rom to the emulator configuration.
+ * @param config - the emulator configuration
+ * @param info - the settings of the rom
+ */
+void applyRomInfo(Config* config, const RomInfo* info);
@@ -0,0 +1,120 @@
+#include "state.h"
+// std
+#include <stdio.h>
+#include <string.h>
+
+// Distinguishes the byte order of the machine that wrote the state
+#define ENDIANNESS_MARKER 0x0102
+
+uint32_t checksum(const void *data, size_t size) {
+  const uint8_t *bytes = data;
+  uint64_t hash = 0xCBF29CE484222325;
+
+  // FNV-1a over 64-bit words, the tail is folded in byte by byte
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, &bytes[i], sizeof(word));
+    hash = (hash ^ word) * 0x100000001B3;
+  }
+  for (; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001B3;
+  }
+
+  return hash ^ (hash >> 32);
+}
+
+void saveState(const Chip8 *chip8, SaveState *saveState) {
+  memcpy(saveState->data, chip8, CHIP8_STATE_SIZE);
+
+  saveState->header.magic = SAVE_STATE_MAGIC;
+  saveState->header.version = SAVE_STATE_VERSION;
+  saveState->header.endianness = ENDIANNESS_MARKER;
+  saveState->header.size = CHIP8_STATE_SIZE;
+  saveState->header.checksum = checksum(saveState->data, CHIP8_STATE_SIZE);
+}
+
+bool loadState(Chip8 *chip8, const SaveState *saveState) {
+  const SaveStateHeader *header = &saveState->header;
+
+  if (header->magic != SAVE_STATE_MAGIC ||
+      header->version != SAVE_STATE_VERSION ||
+      header->endianness != ENDIANNESS_MARKER ||
+      header->size != CHIP8_STATE_SIZE) {
+    fprintf(stderr, "Incompatible save state\n");
+    return false;
+  }
+
+  if (header->checksum != checksum(saveState->data, CHIP8_STATE_SIZE)) {
+    fprintf(stderr, "Corrupted save state\n");
+    return false;
+  }
+
+  // A matching checksum says nothing about where the state came from, the
+  // fields used as indices are checked before any of it is restored
+  Profile profile;
+  uint8_t waitKey;
+  uint8_t stackDepth;
+  memcpy(&profile, &saveState->data[offsetof(Chip8, profile)],
+         sizeof(profile));
+  memcpy(&waitKey, &saveState->data[offsetof(Chip8, waitKey)],
+         sizeof(waitKey));
+  memcpy(&stackDepth, &saveState->data[offsetof(Chip8, stackDepth)],
+         sizeof(stackDepth));
+
+  if ((uint32_t)profile >= PROFILE_COUNT ||
+      (waitKey >= KEYS && waitKey != NO_KEY) || stackDepth > STACK_SIZE) {
+    fprintf(stderr, "Invalid save state\n");
+    return false;
+  }
+
+  memcpy(chip8, saveState->data, CHIP8_STATE_SIZE);
+  chip8->stackPointer &= STACK_SIZE - 1;
+  chip8->dirtyPages = ALL_DIRTY_PAGES;
+
+  // The interpreter is host state, reselect it for the restored profile
+  setProfile(chip8, chip8->profile);
+
+  return true;
+}
+
+bool saveStateFile(const Chip8 *chip8, const char *filePath) {
+  FILE *file = fopen(filePath, "wb");
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open save state file: %s\n", filePath);
+    return false;
+  }
+
+  SaveState state;
+  saveState(chip8, &state);
+
+  const bool written = fwrite(&state, sizeof(state), 1, file) == 1;
+  fclose(file);
+
+  if (!written) {
+    fprintf(stderr, "Failed to write save state file: %s\n", filePath);
+  }
+
+  return written;
+}
+
+bool loadStateFile(Chip8 *chip8, const char *filePath) {
+  FILE *file = fopen(filePath, "rb");
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open save state file: %s\n", filePath);
+    return false;
+  }
+
+  SaveState state;
+  const bool read = fread(&state, sizeof(state), 1, file) == 1;
+  fclose(file);
+
+  if (!read) {
+    fprintf(stderr, "Failed to read save state file: %s\n", filePath);
+    return false;
+  }
+
+  return loadState(chip8, &state);
+}
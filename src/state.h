@@ -0,0 +1,64 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SAVE_STATE_MAGIC 0x54533843  // "C8ST"
+#define SAVE_STATE_VERSION 3
+
+// Save state header, validated before the machine state is restored
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t endianness;
+  uint32_t size;
+  uint32_t checksum;
+} SaveStateHeader;
+
+// Save state, the machine state is stored as a raw copy of the emulator
+// state so restoring it needs no per-field parsing
+typedef struct {
+  SaveStateHeader header;
+  uint8_t data[CHIP8_STATE_SIZE];
+} SaveState;
+
+/**
+ * Computes the word-wise FNV-1a checksum of the given data.
+ * @param data - the data
+ * @param size - the size of the data in bytes
+ * @return the checksum
+ */
+uint32_t checksum(const void* data, size_t size);
+
+/**
+ * Captures the machine state into the save state.
+ * @param chip8 - the emulator state
+ * @param saveState - the save state
+ */
+void saveState(const Chip8* chip8, SaveState* saveState);
+
+/**
+ * Validates the save state and restores the machine state from it.
+ * @param chip8 - the emulator state
+ * @param saveState - the save state
+ * @return true if the save state is valid, false otherwise
+ */
+bool loadState(Chip8* chip8, const SaveState* saveState);
+
+/**
+ * Captures the machine state and writes it to a file.
+ * @param chip8 - the emulator state
+ * @param filePath - the path to the save state file
+ * @return true if saving was successful, false otherwise
+ */
+bool saveStateFile(const Chip8* chip8, const char* filePath);
+
+/**
+ * Reads a save state file and restores the machine state from it.
+ * @param chip8 - the emulator state
+ * @param filePath - the path to the save state file
+ * @return true if loading was successful, false otherwise
+ */
+bool loadStateFile(Chip8* chip8, const char* filePath);
@@ -0,0 +1,74 @@
+#include "trace.h"
+// std
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+// Trace flushed by the crash handler
+static const Trace *crashTrace;
+static const char *crashPath;
+
+// Writes the whole buffer, retrying short writes
+static bool writeAll(const int32_t fd, const void *data, size_t size) {
+  const uint8_t *bytes = data;
+
+  while (size) {
+    const ssize_t written = write(fd, bytes, size);
+    if (written <= 0) return false;
+    bytes += written;
+    size -= written;
+  }
+
+  return true;
+}
+
+bool flushTrace(const Trace *trace, const char *filePath) {
+  const int32_t fd = open(filePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) return false;
+
+  // Records older than the ring size have been overwritten
+  const uint64_t head = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+  const uint64_t count = head < TRACE_SIZE ? head : TRACE_SIZE;
+  const uint64_t oldest = (head - count) & (TRACE_SIZE - 1);
+
+  const TraceHeader header = {
+      .magic = TRACE_MAGIC,
+      .version = TRACE_VERSION,
+      .recordSize = sizeof(TraceRecord),
+      .count = count,
+  };
+
+  // The ring wraps at most once, write it as two runs oldest first
+  const uint64_t first = oldest + count > TRACE_SIZE ? TRACE_SIZE - oldest
+                                                     : count;
+  const bool written =
+      writeAll(fd, &header, sizeof(header)) &&
+      writeAll(fd, &trace->records[oldest], first * sizeof(TraceRecord)) &&
+      writeAll(fd, &trace->records[0], (count - first) * sizeof(TraceRecord));
+
+  close(fd);
+
+  return written;
+}
+
+// Flushes the trace and lets the default action end the process
+static void crashHandler(const int32_t signal) {
+  flushTrace(crashTrace, crashPath);
+
+  struct sigaction action = {.sa_handler = SIG_DFL};
+  sigaction(signal, &action, NULL);
+  raise(signal);
+}
+
+void flushTraceOnCrash(const Trace *trace, const char *filePath) {
+  crashTrace = trace;
+  crashPath = filePath;
+
+  struct sigaction action = {.sa_handler = crashHandler};
+  sigemptyset(&action.sa_mask);
+
+  const int32_t signals[] = {SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT};
+  for (uint32_t i = 0; i < sizeof(signals) / sizeof(*signals); i++) {
+    sigaction(signals[i], &action, NULL);
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "core.h"
+// std
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC 0x52543843  // "C8TR"
+#define TRACE_VERSION 1
+
+// Records kept in the ring, must be a power of two
+#define TRACE_SIZE (1 << 16)
+
+// Executed instruction and the register it targets after execution
+typedef struct {
+  uint64_t cycle;
+  uint16_t programCounter;
+  uint16_t opcode;
+  uint16_t indexRegister;
+  uint8_t vx;
+  uint8_t vf;
+} TraceRecord;
+
+// Single producer ring of the most recent instructions. The emulator is
+// the only writer, readers flush a snapshot without stopping it
+struct Trace {
+  TraceRecord records[TRACE_SIZE];
+  uint64_t head;
+};
+
+// Trace file header, followed by the records from oldest to newest
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+  uint64_t count;
+} TraceHeader;
+
+// Always compiled in, an emulator without a ring costs a predicted branch
+// per instruction
+#define TRACE_INSTRUCTION(chip8, address) traceInstruction(chip8, address)
+
+/**
+ * Appends the executed instruction to the trace ring of the emulator,
+ * if it has one.
+ * @param chip8 - the emulator state
+ * @param address - the address the instruction was fetched from
+ */
+static inline void traceInstruction(const Chip8* chip8,
+                                    const uint16_t address) {
+  Trace* trace = chip8->trace;
+  if (trace == NULL) return;
+
+  const uint64_t head = trace->head;
+  trace->records[head & (TRACE_SIZE - 1)] = (TraceRecord){
+      .cycle = chip8->cycles,
+      .programCounter = address,
+      .opcode = chip8->instruction.raw,
+      .indexRegister = chip8->indexRegister,
+      .vx = chip8->V[chip8->instruction.x],
+      .vf = chip8->V[0xF],
+  };
+
+  // Publish the record to concurrent flushes
+  __atomic_store_n(&trace->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Writes the records in the ring to a file. Only uses async-signal-safe
+ * calls so it can run from a crash handler.
+ * @param trace - the trace ring
+ * @param filePath - the path to the trace file
+ * @return true if writing was successful, false otherwise
+ */
+bool flushTrace(const Trace* trace, const char* filePath);
+
+/**
+ * Flushes the trace ring to the file when the process crashes.
+ * @param trace - the trace ring
+ * @param filePath - the path to the trace file
+ */
+void flushTraceOnCrash(const Trace* trace, const char* filePath);
@@ -0,0 +1,496 @@
+#include "core.h"
+#include "fault.h"
+#include "halt.h"
+#include "image.h"
+#include "manifest.h"
+#include "movie.h"
+#include "state.h"
+// std
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Workers and the ends of their deques sit on separate cache lines
+#define CACHE_LINE 64
+
+// Results of stealing from a deque
+#define DEQUE_EMPTY UINT32_MAX
+#define DEQUE_ABORT (UINT32_MAX - 1)
+
+// Rom run for a number of frames, with the input of a movie or none
+typedef struct {
+  char *romPath;
+  // Shared by every job of the rom, NULL if it could not be read
+  const RomImage *image;
+  char *moviePath;
+  char *statePath;
+  char *framePath;
+  uint32_t frames;  // 0 runs the whole movie
+  Profile profile;
+  uint32_t line;
+  // Filled in by the worker running the job
+  bool completed;
+  bool succeeded;
+  bool exact;
+  uint64_t cycles;
+  uint32_t checksum;
+  // Frame the run halted at and the cycles skipped after it
+  Halt halt;
+  uint32_t haltFrame;
+  uint64_t skipped;
+  // Last fault of the run
+  Fault fault;
+  uint32_t faultCount;
+} Job;
+
+// Chase-Lev deque of job indices. The owner pushes and pops at the bottom,
+// other workers steal from the top, and only a pop of the last job races
+// with steals, settled by a compare and swap on the top
+typedef struct {
+  _Alignas(CACHE_LINE) atomic_long top;
+  _Alignas(CACHE_LINE) atomic_long bottom;
+  atomic_uint *jobs;
+  long mask;
+} Deque;
+
+// Worker thread with its own deque and emulator
+typedef struct {
+  Deque deque;
+  pthread_t thread;
+  uint32_t index;
+  uint32_t random;
+  uint32_t ran;
+  uint32_t stolen;
+} Worker;
+
+static const char *haltNames[] = {
+    [HALT_JUMP] = "jumping to itself",
+    [HALT_KEY_WAIT] = "waiting for a key",
+    [HALT_CYCLE] = "repeating",
+};
+
+static Job *jobs;
+static uint32_t jobCount;
+static RomImageCache images;
+static bool stopOnFault;
+static Worker *workers;
+static uint32_t workerCount;
+
+static void initDeque(Deque *deque, const uint32_t capacity) {
+  long size = 1;
+  while (size < capacity) size <<= 1;
+
+  atomic_init(&deque->top, 0);
+  atomic_init(&deque->bottom, 0);
+  deque->jobs = calloc(size, sizeof(atomic_uint));
+  deque->mask = size - 1;
+}
+
+static void pushJob(Deque *deque, const uint32_t job) {
+  const long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+
+  atomic_store_explicit(&deque->jobs[bottom & deque->mask], job,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+}
+
+static uint32_t popJob(Deque *deque) {
+  const long bottom =
+      atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  if (top > bottom) {
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return DEQUE_EMPTY;
+  }
+
+  uint32_t job = atomic_load_explicit(&deque->jobs[bottom & deque->mask],
+                                      memory_order_relaxed);
+
+  // The last job goes to whoever moves the top first
+  if (top == bottom) {
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+      job = DEQUE_EMPTY;
+    }
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+  }
+
+  return job;
+}
+
+static uint32_t stealJob(Deque *deque) {
+  long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  const long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+  if (top >= bottom) return DEQUE_EMPTY;
+
+  const uint32_t job = atomic_load_explicit(&deque->jobs[top & deque->mask],
+                                            memory_order_relaxed);
+
+  if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                               memory_order_seq_cst,
+                                               memory_order_relaxed)) {
+    return DEQUE_ABORT;
+  }
+
+  return job;
+}
+
+// Steals from the other workers starting at a random one. Jobs are never
+// added once the workers start, so all deques being empty ends the worker
+static uint32_t findJob(Worker *worker) {
+  bool aborted;
+
+  do {
+    aborted = false;
+
+    worker->random ^= worker->random << 13;
+    worker->random ^= worker->random >> 17;
+    worker->random ^= worker->random << 5;
+    const uint32_t first = worker->random % workerCount;
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+      const uint32_t victim = (first + i) % workerCount;
+      if (victim == worker->index) continue;
+
+      const uint32_t job = stealJob(&workers[victim].deque);
+      if (job == DEQUE_ABORT) aborted = true;
+      if (job < DEQUE_ABORT) {
+        worker->stolen++;
+        return job;
+      }
+    }
+  } while (aborted);
+
+  return DEQUE_EMPTY;
+}
+
+// Frames after the given one, up to the frame count or the end of the movie
+static uint32_t framesLeft(const Job *job, const Chip8 *chip8,
+                           const Movie *movie, const uint32_t frame,
+                           const uint32_t instructions) {
+  if (job->frames) return job->frames - frame - 1;
+  if (chip8->cycles >= movie->header.cycles) return 0;
+
+  return (movie->header.cycles - chip8->cycles + instructions - 1) /
+         instructions;
+}
+
+static void runJob(Job *job, Chip8 *chip8, const RomImage **loaded,
+                   const Config *config) {
+  if (job->image == NULL) return;
+  setProfile(chip8, job->profile);
+  powerOnRomImage(chip8, job->image, *loaded);
+  *loaded = job->image;
+
+  Movie movie = {0};
+  uint32_t instructions = config->instructionsPerSecond / FRAME_RATE;
+
+  // A movie starts from the power on state it was recorded with
+  if (job->moviePath != NULL) {
+    if (!loadMovie(&movie, job->moviePath)) return;
+
+    if (strcmp(job->image->fingerprint, movie.header.fingerprint) != 0) {
+      fprintf(stderr, "Movie was recorded with a different rom: %s\n",
+              job->moviePath);
+      destroyMovie(&movie);
+      return;
+    }
+
+    setProfile(chip8, movie.header.profile);
+    seedRandom(chip8, movie.header.seed);
+    instructions = movie.header.instructionsPerSecond / FRAME_RATE;
+  }
+
+  uint32_t next = 0;
+  HaltDetector detector;
+  resetHaltDetector(&detector);
+
+  for (uint32_t frame = 0;
+       job->frames ? frame < job->frames : chip8->cycles < movie.header.cycles;
+       frame++) {
+    while (next < movie.header.eventCount &&
+           movie.events[next].cycle <= chip8->cycles) {
+      setKeypadState(chip8, movie.events[next++].keys);
+      resetHaltDetector(&detector);
+    }
+
+    const FaultKind fault = runFrame(chip8, instructions);
+    chip8->draw = false;
+
+    if (stopOnFault && fault != FAULT_NONE) break;
+
+    // Once the input is over a halted run ends up the same however many
+    // frames are left, so they are skipped
+    if (next == movie.header.eventCount && detectHalt(&detector, chip8)) {
+      const uint64_t cycles = chip8->cycles;
+      uint32_t left = skipHaltedFrames(chip8, &detector,
+                                       framesLeft(job, chip8, &movie, frame,
+                                                  instructions),
+                                       instructions);
+      job->skipped = chip8->cycles - cycles;
+
+      while (left--) {
+        runFrame(chip8, instructions);
+        chip8->draw = false;
+      }
+
+      job->halt = detector.halt;
+      job->haltFrame = frame + 1;
+      break;
+    }
+  }
+
+  job->completed = true;
+  job->cycles = chip8->cycles;
+  job->fault = chip8->fault;
+  job->faultCount = chip8->faultCount;
+  job->checksum = checksum(chip8, CHIP8_STATE_SIZE);
+  job->exact = job->moviePath != NULL && job->frames == 0 &&
+               job->checksum == movie.header.checksum;
+  job->succeeded = (job->statePath == NULL ||
+                    saveStateFile(chip8, job->statePath)) &&
+                   (job->framePath == NULL ||
+                    writeFrame(job->framePath, chip8->frameBuffer)) &&
+                   (job->moviePath == NULL || job->frames || job->exact) &&
+                   !(stopOnFault && job->faultCount);
+
+  destroyMovie(&movie);
+}
+
+static void *runWorker(void *argument) {
+  Worker *worker = argument;
+  Chip8 *chip8 = calloc(1, sizeof(Chip8));
+  // Jobs of the same rom in a row copy only the pages the last one wrote
+  const RomImage *loaded = NULL;
+  Config config = {0};
+  defaultConfig(&config);
+
+  for (;;) {
+    uint32_t job = popJob(&worker->deque);
+    if (job == DEQUE_EMPTY) job = findJob(worker);
+    if (job == DEQUE_EMPTY) break;
+
+    runJob(&jobs[job], chip8, &loaded, &config);
+    worker->ran++;
+  }
+
+  free(chip8);
+
+  return NULL;
+}
+
+// Parses the key=value options following the frame count
+static bool parseOption(Job *job, char *option) {
+  char *equals = strchr(option, '=');
+  if (equals == NULL) return false;
+
+  *equals = '\0';
+  const char *value = equals + 1;
+
+  if (strcmp(option, "profile") == 0) {
+    return parseProfile(value, &job->profile);
+  }
+  if (strcmp(option, "state") == 0) {
+    job->statePath = strdup(value);
+    return true;
+  }
+  if (strcmp(option, "frame") == 0) {
+    job->framePath = strdup(value);
+    return true;
+  }
+
+  return false;
+}
+
+// Lines are a rom, a movie or -, a frame count and options
+static bool loadManifest(const char *path, const Profile profile) {
+  Manifest manifest;
+  if (!openManifest(&manifest, path)) return false;
+
+  uint32_t capacity = 0;
+  bool valid = true;
+  char *romPath;
+
+  while (valid && (romPath = nextManifestLine(&manifest)) != NULL) {
+    if (jobCount == capacity) {
+      capacity = capacity ? capacity * 2 : 1024;
+      jobs = realloc(jobs, capacity * sizeof(Job));
+    }
+
+    Job *job = &jobs[jobCount++];
+    *job = (Job){.profile = profile, .line = manifest.lineNumber};
+    job->romPath = strdup(romPath);
+    job->image = cachedRomImage(&images, romPath);
+
+    char *moviePath = nextManifestField(&manifest);
+    char *frames = nextManifestField(&manifest);
+    valid = moviePath != NULL && frames != NULL;
+
+    if (valid) {
+      if (strcmp(moviePath, "-") != 0) job->moviePath = strdup(moviePath);
+      job->frames = strtoul(frames, NULL, 0);
+      // Only a movie knows how long to run for
+      valid = job->frames || job->moviePath != NULL;
+    }
+
+    for (char *token = nextManifestField(&manifest); valid && token;
+         token = nextManifestField(&manifest)) {
+      valid = parseOption(job, token);
+    }
+
+    if (!valid) {
+      fprintf(stderr, "Invalid job on line %u of %s\n", manifest.lineNumber,
+              path);
+    }
+  }
+
+  closeManifest(&manifest);
+
+  return valid;
+}
+
+static double seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  const char *usage =
+      "Usage: chip8-batch [-j threads] [-p profile] [-q] [-f] <manifest>\n";
+  const char *profileName = NULL;
+  long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+  bool quiet = false;
+  int32_t option;
+
+  while ((option = getopt(argc, argv, "j:p:qf")) != -1) {
+    switch (option) {
+      case 'j':
+        threadCount = strtol(optarg, NULL, 0);
+        break;
+      case 'p':
+        profileName = optarg;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      case 'f':
+        stopOnFault = true;
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 1 || threadCount < 1) {
+    fprintf(stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+
+  Config config = {0};
+  defaultConfig(&config);
+
+  if (profileName != NULL && !parseProfile(profileName, &config.profile)) {
+    fprintf(stderr, "Unknown profile: %s\n", profileName);
+    return EXIT_FAILURE;
+  }
+
+  if (!loadManifest(argv[optind], config.profile)) return EXIT_FAILURE;
+
+  // Every worker starts with a contiguous share of the jobs, pushed in
+  // reverse so it runs them in manifest order and thieves take the last
+  workerCount = threadCount;
+  workers = aligned_alloc(CACHE_LINE, workerCount * sizeof(Worker));
+  memset(workers, 0, workerCount * sizeof(Worker));
+
+  for (uint32_t i = 0; i < workerCount; i++) {
+    const uint32_t first = (uint64_t)jobCount * i / workerCount;
+    const uint32_t last = (uint64_t)jobCount * (i + 1) / workerCount;
+
+    workers[i].index = i;
+    workers[i].random = i * 2654435761u | 1;
+    initDeque(&workers[i].deque, last - first);
+
+    for (uint32_t job = last; job > first; job--) {
+      pushJob(&workers[i].deque, job - 1);
+    }
+  }
+
+  const double begin = seconds();
+
+  for (uint32_t i = 0; i < workerCount; i++) {
+    pthread_create(&workers[i].thread, NULL, runWorker, &workers[i]);
+  }
+
+  for (uint32_t i = 0; i < workerCount; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+
+  const double elapsed = seconds() - begin;
+
+  // Results in manifest order, whichever worker ran them
+  uint32_t failed = 0;
+  uint32_t halted = 0;
+  uint64_t cycles = 0;
+  uint64_t skipped = 0;
+
+  for (uint32_t i = 0; i < jobCount; i++) {
+    const Job *job = &jobs[i];
+
+    failed += !job->succeeded;
+    cycles += job->cycles;
+    halted += job->halt != HALT_NONE;
+    skipped += job->skipped;
+
+    if (quiet && job->succeeded) continue;
+
+    if (!job->completed) {
+      printf("FAIL %s(line %u) not run\n", job->romPath, job->line);
+      continue;
+    }
+
+    printf("%s %s %llu cycles %08X", job->succeeded ? "OK  " : "FAIL",
+           job->romPath, (unsigned long long)job->cycles, job->checksum);
+    if (job->moviePath != NULL && job->frames == 0) {
+      printf(job->exact ? " matches the movie" : " DIVERGED from the movie");
+    }
+    if (job->halt != HALT_NONE) {
+      printf(" %s at frame %u", haltNames[job->halt], job->haltFrame);
+    }
+    if (job->faultCount) {
+      printf(" %u faults, last %s at 0x%03X (%04X)", job->faultCount,
+             faultName(job->fault.kind), job->fault.address,
+             job->fault.opcode);
+    }
+    printf("\n");
+  }
+
+  // Skipped cycles were never executed and do not count towards the speed
+  printf(
+      "%u jobs, %u failed, %u halted, %llu cycles, %llu skipped, in %.3fs, "
+      "%.1f MIPS\n",
+      jobCount, failed, halted, (unsigned long long)cycles,
+      (unsigned long long)skipped, elapsed,
+      (cycles - skipped) / (elapsed > 0 ? elapsed : 1e-9) / 1e6);
+
+  for (uint32_t i = 0; i < workerCount; i++) {
+    printf("  worker %u ran %u jobs, %u stolen\n", i, workers[i].ran,
+           workers[i].stolen);
+  }
+
+  destroyRomImageCache(&images);
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
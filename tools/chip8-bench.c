@@ -0,0 +1,344 @@
+#include "chip8.h"
+#include "core.h"
+#include "ensemble.h"
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Every measurement is repeated and the fastest run is reported, which is
+// the least disturbed by the rest of the system
+#define REPEATS 5
+
+// Instructions executed per run of an opcode kernel
+#define KERNEL_INSTRUCTIONS (1 << 20)
+
+// Frames emulated per run of a rom unless given with -f
+#define DEFAULT_FRAMES 100000
+
+// Frames drawn per run of the draw benchmarks
+#define DRAW_FRAMES 500
+
+// Audio callback buffer, as large as the default sample size in bytes
+#define AUDIO_BUFFER_SIZE 4096
+#define AUDIO_CALLBACKS 4096
+
+// Kernels fill ram up to here and jump back to PROGRAM_START, leaving the
+// rest of ram for the stores
+#define KERNEL_END 0xF00
+#define KERNEL_DATA 0xF80
+
+// A single instruction repeated through ram, with V0 and I set beforehand
+typedef struct {
+  const char *name;
+  uint16_t opcode;
+  uint8_t v0;
+} Kernel;
+
+static const Kernel kernels[] = {
+    {"6XKK ld", 0x6012, 0},
+    {"7XKK add", 0x7001, 0},
+    {"8XY2 and", 0x8012, 0},
+    {"8XY4 add", 0x8014, 0},
+    {"8XY6 shr", 0x8016, 0},
+    {"ANNN ld", 0xA300, 0},
+    {"CXKK rnd", 0xC0FF, 0},
+    {"3XKK skip taken", 0x3000, 0},
+    {"3XKK skip not taken", 0x3001, 0},
+    {"5XY0 skip taken", 0x5000, 0},
+    {"EX9E skip not taken", 0xE09E, 0},
+    // Sprites at a byte aligned, an unaligned and a clipped position
+    {"DXY1 x=0", 0xD011, 0},
+    {"DXY5 x=0", 0xD015, 0},
+    {"DXYF x=0", 0xD01F, 0},
+    {"DXY1 x=3", 0xD011, 3},
+    {"DXY5 x=3", 0xD015, 3},
+    {"DXYF x=3", 0xD01F, 3},
+    {"DXY5 x=60", 0xD015, 60},
+    {"DXYF x=60", 0xD01F, 60},
+    {"FX33 bcd", 0xF033, 0},
+    {"FX55 store", 0xFF55, 0},
+    {"FX65 load", 0xFF65, 0},
+};
+
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(*kernels))
+
+// Loop with a typical mix of loads, arithmetic, skips, sprites and calls,
+// counting V0 down and drawing the digit in V1 every iteration
+static const uint8_t mixRom[] = {
+    0x60, 0x20,  // 200  LD V0, 0x20
+    0x61, 0x00,  // 202  LD V1, 0x00
+    0x62, 0x08,  // 204  LD V2, 0x08
+    0x63, 0x04,  // 206  LD V3, 0x04
+    0x22, 0x20,  // 208  CALL 0x220
+    0x70, 0xFF,  // 20A  ADD V0, 0xFF
+    0x30, 0x00,  // 20C  SE V0, 0x00
+    0x12, 0x08,  // 20E  JP 0x208
+    0x71, 0x01,  // 210  ADD V1, 0x01
+    0x81, 0x42,  // 212  AND V1, V4
+    0x00, 0xE0,  // 214  CLS
+    0x12, 0x00,  // 216  JP 0x200
+    0x00, 0x00,  // 218
+    0x00, 0x00,  // 21A
+    0x00, 0x00,  // 21C
+    0x00, 0x00,  // 21E
+    0xF1, 0x29,  // 220  LD F, V1
+    0xD2, 0x35,  // 222  DRW V2, V3, 5
+    0x84, 0x14,  // 224  ADD V4, V1
+    0x84, 0x06,  // 226  SHR V4
+    0xA3, 0x00,  // 228  LD I, 0x300
+    0xF2, 0x33,  // 22A  LD B, V2
+    0xF2, 0x65,  // 22C  LD V2, [I]
+    0x62, 0x08,  // 22E  LD V2, 0x08
+    0x64, 0x0F,  // 230  LD V4, 0x0F
+    0x00, 0xEE,  // 232  RET
+};
+
+static Chip8 chip8;
+static Ensemble ensemble;
+static uint32_t resultCount = 0;
+
+static double nanoseconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static void printString(const char *text) {
+  putchar('"');
+  for (; *text; text++) {
+    if (*text == '"' || *text == '\\') putchar('\\');
+    putchar(*text);
+  }
+  putchar('"');
+}
+
+// Prints a result as an element of the benchmarks array
+static void report(const char *group, const char *name, const char *unit,
+                   const double value, const uint64_t iterations) {
+  printf("%s\n    {\"group\": ", resultCount++ ? "," : "");
+  printString(group);
+  printf(", \"name\": ");
+  printString(name);
+  printf(", \"unit\": ");
+  printString(unit);
+  printf(", \"value\": %.3f, \"iterations\": %llu}", value,
+         (unsigned long long)iterations);
+}
+
+static void benchmarkKernel(const Kernel *kernel) {
+  static uint8_t rom[KERNEL_END - PROGRAM_START + 2];
+
+  for (uint32_t i = 0; i < sizeof(rom) - 2; i += 2) {
+    rom[i] = kernel->opcode >> 8;
+    rom[i + 1] = kernel->opcode & 0xFF;
+  }
+  rom[sizeof(rom) - 2] = 0x10 | PROGRAM_START >> 8;
+  rom[sizeof(rom) - 1] = PROGRAM_START & 0xFF;
+
+  // SCHIP leaves I in place on FX55 and FX65 and clips sprites at the edge
+  resetChip8(&chip8);
+  setProfile(&chip8, PROFILE_SCHIP);
+  loadRomData(&chip8, rom, sizeof(rom));
+  chip8.V[0] = kernel->v0;
+  chip8.indexRegister = KERNEL_DATA;
+
+  // Sprites are read from the font
+  if ((kernel->opcode & 0xF000) == 0xD000) chip8.indexRegister = 0;
+
+  double best = 0;
+  for (uint32_t repeat = 0; repeat < REPEATS; repeat++) {
+    const double begin = nanoseconds();
+    runFrame(&chip8, KERNEL_INSTRUCTIONS);
+    const double elapsed = nanoseconds() - begin;
+
+    if (repeat == 0 || elapsed < best) best = elapsed;
+  }
+
+  report("opcode", kernel->name, "ns/instruction", best / KERNEL_INSTRUCTIONS,
+         KERNEL_INSTRUCTIONS);
+}
+
+// Emulates frames at the configured speed as the frontend does
+static void benchmarkRom(const char *name, const uint32_t instructions,
+                         const uint32_t frames) {
+  static uint8_t loaded[CHIP8_STATE_SIZE];
+  memcpy(loaded, &chip8, CHIP8_STATE_SIZE);
+
+  double best = 0;
+  uint64_t cycles = 0;
+
+  for (uint32_t repeat = 0; repeat < REPEATS; repeat++) {
+    // Every run starts from the freshly loaded rom
+    memcpy(&chip8, loaded, CHIP8_STATE_SIZE);
+
+    const double begin = nanoseconds();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+      runFrame(&chip8, instructions);
+      chip8.draw = false;
+    }
+    const double elapsed = nanoseconds() - begin;
+
+    if (repeat == 0 || elapsed < best) {
+      best = elapsed;
+      cycles = chip8.cycles;
+    }
+  }
+
+  report("mips", name, "MIPS", cycles / best * 1e3, cycles);
+}
+
+// Emulates the same frames on every instance of an ensemble, each seeded
+// differently, reporting the instructions of all instances together
+static void benchmarkEnsemble(const char *name, const uint32_t instructions,
+                              const uint32_t frames) {
+  const uint32_t ensembleFrames =
+      frames > ENSEMBLE_LANES ? frames / ENSEMBLE_LANES : 1;
+
+  double best = 0;
+  for (uint32_t repeat = 0; repeat < REPEATS; repeat++) {
+    initEnsemble(&ensemble, &chip8, ENSEMBLE_LANES);
+    for (uint32_t lane = 0; lane < ENSEMBLE_LANES; lane++) {
+      seedRandom(&ensemble.instances[lane], lane);
+    }
+
+    const double begin = nanoseconds();
+    for (uint32_t frame = 0; frame < ensembleFrames; frame++) {
+      runEnsembleFrame(&ensemble, instructions);
+    }
+    const double elapsed = nanoseconds() - begin;
+
+    if (repeat == 0 || elapsed < best) best = elapsed;
+  }
+
+  const uint64_t cycles =
+      (uint64_t)ENSEMBLE_LANES * ensembleFrames * instructions;
+  report("ensemble", name, "MIPS", cycles / best * 1e3, cycles);
+}
+
+static bool loadBenchmarkRom(const Profile profile, const char *path) {
+  resetChip8(&chip8);
+  setProfile(&chip8, profile);
+
+  if (path == NULL) return loadRomData(&chip8, mixRom, sizeof(mixRom));
+  return loadRom(&chip8, path);
+}
+
+static void benchmarkDraw(const Sdl *sdl, const Config *config,
+                          const char *name, const uint32_t step) {
+  for (uint32_t i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; i++) {
+    chip8.frameBuffer[i] = step && (i + i / WINDOW_WIDTH) % step == 0;
+  }
+
+  double best = 0;
+  for (uint32_t repeat = 0; repeat < REPEATS; repeat++) {
+    const double begin = nanoseconds();
+    for (uint32_t frame = 0; frame < DRAW_FRAMES; frame++) {
+      chip8.draw = true;
+      draw(sdl, &chip8, config);
+    }
+    const double elapsed = nanoseconds() - begin;
+
+    if (repeat == 0 || elapsed < best) best = elapsed;
+  }
+
+  report("draw", name, "us/frame", best / DRAW_FRAMES / 1e3, DRAW_FRAMES);
+}
+
+static void benchmarkSquareWave(Config *config) {
+  static uint8_t stream[AUDIO_BUFFER_SIZE];
+  const uint64_t samples =
+      (uint64_t)AUDIO_CALLBACKS * AUDIO_BUFFER_SIZE / sizeof(int16_t);
+
+  double best = 0;
+  for (uint32_t repeat = 0; repeat < REPEATS; repeat++) {
+    const double begin = nanoseconds();
+    for (uint32_t i = 0; i < AUDIO_CALLBACKS; i++) {
+      squareWave(config, stream, sizeof(stream));
+    }
+    const double elapsed = nanoseconds() - begin;
+
+    if (repeat == 0 || elapsed < best) best = elapsed;
+  }
+
+  report("audio", "squareWave", "ns/sample", best / samples, samples);
+}
+
+int main(int argc, char *argv[]) {
+  const char *usage =
+      "Usage: chip8-bench [-p profile] [-f frames] [-n] [rom...]\n";
+  const char *profileName = NULL;
+  uint32_t frames = DEFAULT_FRAMES;
+  bool graphics = true;
+  int32_t option;
+
+  while ((option = getopt(argc, argv, "p:f:n")) != -1) {
+    switch (option) {
+      case 'p':
+        profileName = optarg;
+        break;
+      case 'f':
+        frames = strtoul(optarg, NULL, 0);
+        break;
+      case 'n':
+        graphics = false;
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+  }
+
+  Config config = {0};
+  defaultConfig(&config);
+
+  if (profileName != NULL && !parseProfile(profileName, &config.profile)) {
+    fprintf(stderr, "Unknown profile: %s\n", profileName);
+    return EXIT_FAILURE;
+  }
+
+  const uint32_t instructions = config.instructionsPerSecond / FRAME_RATE;
+
+  printf("{\n  \"benchmarks\": [");
+
+  for (uint32_t i = 0; i < KERNEL_COUNT; i++) {
+    benchmarkKernel(&kernels[i]);
+  }
+
+  // The synthetic mix and then every rom given, on their own and as an
+  // ensemble
+  if (loadBenchmarkRom(config.profile, NULL)) {
+    benchmarkEnsemble("synthetic mix", instructions, frames);
+    benchmarkRom("synthetic mix", instructions, frames);
+  }
+
+  for (int32_t i = optind; i < argc; i++) {
+    if (!loadBenchmarkRom(config.profile, argv[i])) return EXIT_FAILURE;
+    benchmarkEnsemble(argv[i], instructions, frames);
+    benchmarkRom(argv[i], instructions, frames);
+  }
+
+  benchmarkSquareWave(&config);
+
+  // Drawing needs a window, SDL_VIDEODRIVER=dummy measures without one
+  if (graphics) {
+    Sdl sdl = {0};
+
+    if (SDL_Init(SDL_INIT_VIDEO) != 0 || !initGraphics(&sdl, &config)) {
+      fprintf(stderr, "Failed to initialize SDL: %s\n", SDL_GetError());
+      return EXIT_FAILURE;
+    }
+
+    benchmarkDraw(&sdl, &config, "empty", 0);
+    benchmarkDraw(&sdl, &config, "half", 2);
+    benchmarkDraw(&sdl, &config, "full", 1);
+
+    cleanup(&sdl);
+  }
+
+  printf("\n  ]\n}\n");
+
+  return EXIT_SUCCESS;
+}
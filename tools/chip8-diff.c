@@ -0,0 +1,356 @@
+#include "core.h"
+#include "disasm.h"
+#include "ensemble.h"
+#include "movie.h"
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Instructions between state comparisons unless given with -n, intervals
+// span frames
+#define DEFAULT_INTERVAL 1024
+
+// Cycles compared without a movie unless given with -c
+#define DEFAULT_CYCLES 10000000
+
+// Execution engine under test, running each side of the pair on a state of
+// its own
+typedef struct {
+  const char *name;
+  // Takes over the emulator state, returning the state the engine runs on
+  Chip8 *(*start)(const uint32_t side, const Chip8 *chip8);
+  // Executes instructions within a frame, without updating the timers
+  void (*run)(const uint32_t side, const uint32_t instructions);
+  // Restores the machine state between runs
+  void (*restore)(const uint32_t side, const uint8_t *state);
+} Engine;
+
+// States of the interpreters and of the ensembles, one of each per side
+static Chip8 interpreted[2];
+static Ensemble ensembles[2];
+
+static Chip8 *startInterpreted(const uint32_t side, const Chip8 *chip8) {
+  interpreted[side] = *chip8;
+  return &interpreted[side];
+}
+
+static void runSpecialised(const uint32_t side, const uint32_t instructions) {
+  Chip8 *chip8 = &interpreted[side];
+
+  for (uint32_t i = 0; i < instructions; i++) {
+    chip8->interpreter(chip8);
+  }
+}
+
+static void runReference(const uint32_t side, const uint32_t instructions) {
+  for (uint32_t i = 0; i < instructions; i++) {
+    emulateReference(&interpreted[side]);
+  }
+}
+
+static void restoreInterpreted(const uint32_t side, const uint8_t *state) {
+  memcpy(&interpreted[side], state, CHIP8_STATE_SIZE);
+}
+
+// A single instance of an ensemble, executing most instructions in its
+// vector code instead of through an interpreter
+static Chip8 *startEnsemble(const uint32_t side, const Chip8 *chip8) {
+  initEnsemble(&ensembles[side], chip8, 1);
+  return &ensembles[side].instances[0];
+}
+
+static void runEnsemble(const uint32_t side, const uint32_t instructions) {
+  runEnsembleInstructions(&ensembles[side], instructions);
+}
+
+static void restoreEnsemble(const uint32_t side, const uint8_t *state) {
+  restoreInstance(&ensembles[side], 0, state);
+}
+
+static const Engine engines[] = {
+    {"specialised", startInterpreted, runSpecialised, restoreInterpreted},
+    {"reference", startInterpreted, runReference, restoreInterpreted},
+    {"ensemble", startEnsemble, runEnsemble, restoreEnsemble},
+};
+
+#define ENGINE_COUNT (sizeof(engines) / sizeof(*engines))
+
+// Engines in lockstep, the states they run on and their states at the last
+// matching comparison, along with the next keypad change of the movie
+static const Engine *pair[2];
+static Chip8 *chip8s[2];
+static uint8_t checkpoints[2][CHIP8_STATE_SIZE];
+static uint32_t nextEvents[2];
+static uint32_t checkpointEvents[2];
+
+// Frames the engines run, as the movie replays them
+static Movie movie;
+static uint32_t instructionsPerFrame;
+
+static const Engine *findEngine(const char *name) {
+  for (uint32_t i = 0; i < ENGINE_COUNT; i++) {
+    if (strcmp(name, engines[i].name) == 0) return &engines[i];
+  }
+
+  fprintf(stderr, "Unknown engine: %s\n", name);
+  return NULL;
+}
+
+// Runs both engines the number of instructions on from where they are,
+// applying the keypad changes before and updating the timers after every
+// frame the instructions reach into
+static void runEngines(const uint32_t instructions) {
+  for (uint32_t side = 0; side < 2; side++) {
+    Chip8 *chip8 = chip8s[side];
+
+    for (uint32_t left = instructions; left;) {
+      const uint32_t done = chip8->cycles % instructionsPerFrame;
+
+      while (done == 0 && nextEvents[side] < movie.header.eventCount &&
+             movie.events[nextEvents[side]].cycle <= chip8->cycles) {
+        setKeypadState(chip8, movie.events[nextEvents[side]++].keys);
+      }
+
+      const uint32_t count = instructionsPerFrame - done < left
+                                 ? instructionsPerFrame - done
+                                 : left;
+      pair[side]->run(side, count);
+      left -= count;
+
+      if (chip8->cycles % instructionsPerFrame == 0) {
+        updateTimers(chip8);
+        chip8->draw = false;
+      }
+    }
+  }
+}
+
+static bool statesMatch(void) {
+  return memcmp(chip8s[0], chip8s[1], CHIP8_STATE_SIZE) == 0;
+}
+
+static void saveCheckpoints(void) {
+  for (uint32_t i = 0; i < 2; i++) {
+    memcpy(checkpoints[i], chip8s[i], CHIP8_STATE_SIZE);
+    checkpointEvents[i] = nextEvents[i];
+  }
+}
+
+static void restoreCheckpoints(void) {
+  for (uint32_t i = 0; i < 2; i++) {
+    pair[i]->restore(i, checkpoints[i]);
+    nextEvents[i] = checkpointEvents[i];
+  }
+}
+
+// Finds how many instructions after the checkpoints the engines first
+// differ, knowing they match after none and differ after the interval. A
+// difference can be overwritten again, so the interval is replayed an
+// instruction at a time rather than bisected
+static uint32_t firstDifference(const uint32_t interval) {
+  restoreCheckpoints();
+
+  for (uint32_t count = 1; count < interval; count++) {
+    runEngines(1);
+    if (!statesMatch()) return count;
+  }
+
+  return interval;
+}
+
+static void printDifference(const char *name, const uint32_t a,
+                            const uint32_t b) {
+  if (a != b) printf("  %-14s %12X %12X\n", name, a, b);
+}
+
+// Lists the parts of the machine state the engines disagree on
+static void printDifferences(const Chip8 *a, const Chip8 *b) {
+  char name[16];
+
+  printf("  %-14s %12s %12s\n", "", pair[0]->name, pair[1]->name);
+
+  for (uint32_t i = 0; i < NUM_REGISTERS; i++) {
+    snprintf(name, sizeof(name), "V%X", i);
+    printDifference(name, a->V[i], b->V[i]);
+  }
+
+  printDifference("I", a->indexRegister, b->indexRegister);
+  printDifference("PC", a->programCounter, b->programCounter);
+  printDifference("SP", a->stackPointer, b->stackPointer);
+  printDifference("stackDepth", a->stackDepth, b->stackDepth);
+  printDifference("DT", a->delayTimer, b->delayTimer);
+  printDifference("ST", a->soundTimer, b->soundTimer);
+  printDifference("draw", a->draw, b->draw);
+  printDifference("waitKey", a->waitKey, b->waitKey);
+  printDifference("randomState", a->randomState, b->randomState);
+  printDifference("cycles", a->cycles, b->cycles);
+
+  for (uint32_t i = 0; i < STACK_SIZE; i++) {
+    snprintf(name, sizeof(name), "stack[%u]", i);
+    printDifference(name, a->stack[i], b->stack[i]);
+  }
+
+  for (uint32_t i = 0; i < RAM_SIZE; i++) {
+    snprintf(name, sizeof(name), "ram[%03X]", i);
+    printDifference(name, a->ram[i], b->ram[i]);
+  }
+
+  uint32_t pixels = 0;
+  for (uint32_t i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; i++) {
+    pixels += a->frameBuffer[i] != b->frameBuffer[i];
+  }
+  if (pixels) printf("  %u pixels differ\n", pixels);
+}
+
+// Replays the interval up to the first differing instruction and reports it
+static void reportDivergence(const uint32_t interval) {
+  const uint32_t count = firstDifference(interval);
+
+  restoreCheckpoints();
+  runEngines(count - 1);
+
+  const Chip8 *chip8 = chip8s[0];
+  const uint16_t address = chip8->programCounter & (RAM_SIZE - 1);
+  const uint16_t opcode = chip8->ram[address] << 8 |
+                          chip8->ram[(address + 1) & (RAM_SIZE - 1)];
+  char mnemonic[32];
+  disassemble(opcode, mnemonic, sizeof(mnemonic));
+
+  printf("Diverged at cycle %llu executing %03X  %04X  %s\n",
+         (unsigned long long)chip8->cycles, address, opcode, mnemonic);
+
+  runEngines(1);
+  printDifferences(chip8s[0], chip8s[1]);
+}
+
+int main(int argc, char *argv[]) {
+  const char *usage =
+      "Usage: chip8-diff [-e engine,engine] [-m movie] [-p profile] "
+      "[-n interval] [-c cycles] <rom>\n";
+  const char *engineNames = "specialised,reference";
+  const char *moviePath = NULL;
+  const char *profileName = NULL;
+  uint32_t interval = DEFAULT_INTERVAL;
+  uint64_t cycles = DEFAULT_CYCLES;
+  int32_t option;
+
+  while ((option = getopt(argc, argv, "e:m:p:n:c:")) != -1) {
+    switch (option) {
+      case 'e':
+        engineNames = optarg;
+        break;
+      case 'm':
+        moviePath = optarg;
+        break;
+      case 'p':
+        profileName = optarg;
+        break;
+      case 'n':
+        interval = strtoul(optarg, NULL, 0);
+        break;
+      case 'c':
+        cycles = strtoull(optarg, NULL, 0);
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 1 || interval == 0) {
+    fprintf(stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+
+  // Engines are given as a comma separated pair
+  char names[64];
+  snprintf(names, sizeof(names), "%s", engineNames);
+  char *comma = strchr(names, ',');
+  if (comma == NULL) {
+    fprintf(stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+  *comma = '\0';
+
+  pair[0] = findEngine(names);
+  pair[1] = findEngine(comma + 1);
+  if (pair[0] == NULL || pair[1] == NULL) {
+    return EXIT_FAILURE;
+  }
+
+  Config config = {0};
+  defaultConfig(&config);
+
+  if (profileName != NULL && !parseProfile(profileName, &config.profile)) {
+    fprintf(stderr, "Unknown profile: %s\n", profileName);
+    return EXIT_FAILURE;
+  }
+
+  static Chip8 emulator;
+  Chip8 *chip8 = &emulator;
+  if (!initChip8(chip8, &config) || !loadRom(chip8, argv[optind])) {
+    return EXIT_FAILURE;
+  }
+
+  // A movie supplies the profile, speed, seed, inputs and length
+  uint32_t seed = 0;
+
+  if (moviePath != NULL) {
+    if (!loadMovie(&movie, moviePath)) return EXIT_FAILURE;
+
+    char fingerprint[SHA1_SIZE * 2 + 1];
+    romFingerprint(&chip8->ram[PROGRAM_START], chip8->romSize, fingerprint);
+    if (strcmp(fingerprint, movie.header.fingerprint) != 0) {
+      fprintf(stderr, "Movie was recorded with a different rom\n");
+      return EXIT_FAILURE;
+    }
+
+    setProfile(chip8, movie.header.profile);
+    config.instructionsPerSecond = movie.header.instructionsPerSecond;
+    seed = movie.header.seed;
+    cycles = movie.header.cycles;
+  }
+
+  instructionsPerFrame = config.instructionsPerSecond / FRAME_RATE;
+  if (instructionsPerFrame == 0) {
+    fprintf(stderr, "Less than an instruction per frame\n");
+    destroyMovie(&movie);
+    return EXIT_FAILURE;
+  }
+
+  seedRandom(chip8, seed);
+  for (uint32_t i = 0; i < 2; i++) {
+    chip8s[i] = pair[i]->start(i, chip8);
+  }
+
+  // Frames as the movie replays them, compared every interval
+  uint64_t comparisons = 0;
+  const clock_t begin = clock();
+
+  while (chip8s[0]->cycles < cycles) {
+    const uint64_t left = cycles - chip8s[0]->cycles;
+    const uint32_t count = left < interval ? left : interval;
+
+    saveCheckpoints();
+    runEngines(count);
+    comparisons++;
+
+    if (!statesMatch()) {
+      reportDivergence(count);
+      destroyMovie(&movie);
+      return EXIT_FAILURE;
+    }
+  }
+
+  const double elapsed = (double)(clock() - begin) / CLOCKS_PER_SEC;
+  printf("%s and %s match over %llu cycles, %llu comparisons in %.3fs\n",
+         pair[0]->name, pair[1]->name, (unsigned long long)chip8s[0]->cycles,
+         (unsigned long long)comparisons, elapsed);
+
+  destroyMovie(&movie);
+
+  return EXIT_SUCCESS;
+}
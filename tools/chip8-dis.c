@@ -0,0 +1,219 @@
+#include "core.h"
+#include "disasm.h"
+#include "flowgraph.h"
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Analysed rom, ram is only read
+static Chip8 chip8;
+static ControlFlowGraph graph;
+
+static uint16_t opcodeAt(const uint16_t address) {
+  return chip8.ram[address] << 8 | chip8.ram[address + 1];
+}
+
+static const char *labelPrefix(const uint16_t address) {
+  return graph.flags[address] & ADDRESS_FUNCTION ? "sub" : "loc";
+}
+
+// Marks the functions called from the function entered at the address,
+// following its blocks up to the returns without descending into calls
+static void findCallees(const uint16_t entry, bool *callees) {
+  static bool visited[RAM_SIZE];
+  static uint16_t worklist[RAM_SIZE];
+  uint32_t count = 0;
+
+  memset(visited, 0, sizeof(visited));
+  worklist[count++] = entry;
+  visited[entry] = true;
+
+  while (count) {
+    const BasicBlock *block = findBlock(&graph, worklist[--count]);
+    if (block == NULL) continue;
+
+    if (block->exit == EXIT_CALL) callees[block->target] = true;
+
+    for (uint32_t i = 0; i < 2; i++) {
+      const uint16_t successor = block->successors[i];
+      if (successor < RAM_SIZE && !visited[successor]) {
+        visited[successor] = true;
+        worklist[count++] = successor;
+      }
+    }
+  }
+}
+
+static void printData(const uint16_t start, const uint16_t end) {
+  for (uint16_t address = start; address < end;) {
+    if (graph.flags[address] & ADDRESS_LOADED) {
+      printf("\ndat_%03X:\n", address);
+    }
+
+    // A line ends after 8 bytes or before the next loaded address
+    printf("  %03X  DB", address);
+    uint32_t count = 0;
+    do {
+      printf(" 0x%02X", chip8.ram[address++]);
+    } while (++count < 8 && address < end &&
+             !(graph.flags[address] & ADDRESS_LOADED));
+    printf("\n");
+  }
+}
+
+static void printBlock(const BasicBlock *block) {
+  char mnemonic[32];
+
+  printf("\n%s_%03X:\n", labelPrefix(block->start), block->start);
+
+  for (uint16_t pc = block->start; pc < block->end; pc += 2) {
+    disassemble(opcodeAt(pc), mnemonic, sizeof(mnemonic));
+    if (graph.flags[pc] & ADDRESS_WRITTEN) {
+      printf("  %03X  %04X  %-16s; overwritten\n", pc, opcodeAt(pc), mnemonic);
+    } else {
+      printf("  %03X  %04X  %s\n", pc, opcodeAt(pc), mnemonic);
+    }
+  }
+
+  switch (block->exit) {
+    case EXIT_HALT:
+      printf("  ; halts\n");
+      break;
+    case EXIT_INDIRECT:
+      printf("  ; indirect jump from 0x%03X\n", block->target);
+      break;
+    case EXIT_INVALID:
+      printf("  ; invalid instruction, runs into data?\n");
+      break;
+    default:
+      break;
+  }
+
+  for (uint32_t i = 0; i < block->writeCount; i++) {
+    const WriteRange *range = &block->writes[i];
+    if (writesCode(&graph, range)) {
+      printf("  ; self-modifying, writes code in 0x%03X-0x%03X\n",
+             range->start, range->end - 1);
+    }
+  }
+}
+
+static void printListing(const char *romName) {
+  const uint16_t romEnd = PROGRAM_START + chip8.romSize;
+  uint16_t address = PROGRAM_START;
+
+  printf("; %s, %u bytes, %u blocks\n", romName, chip8.romSize,
+         graph.blockCount);
+
+  // Blocks in address order, with the unreached bytes between them
+  for (uint32_t i = 0; i < graph.blockCount; i++) {
+    const BasicBlock *block = &graph.blocks[i];
+
+    if (block->start > address && address < romEnd) {
+      printData(address, block->start < romEnd ? block->start : romEnd);
+    }
+
+    printBlock(block);
+    if (block->end > address) address = block->end;
+  }
+
+  if (address < romEnd) printData(address, romEnd);
+
+  printf("\n; Call graph\n");
+  for (uint32_t entry = 0; entry < RAM_SIZE; entry++) {
+    if (!(graph.flags[entry] & ADDRESS_FUNCTION)) continue;
+
+    static bool callees[RAM_SIZE];
+    memset(callees, 0, sizeof(callees));
+    findCallees(entry, callees);
+
+    printf("; sub_%03X ->", entry);
+    for (uint32_t callee = 0; callee < RAM_SIZE; callee++) {
+      if (callees[callee]) printf(" sub_%03X", callee);
+    }
+    printf("\n");
+  }
+}
+
+static void printGraphviz(const char *romName) {
+  char mnemonic[32];
+
+  printf("digraph \"%s\" {\n", romName);
+  printf("  node [shape=box, fontname=\"monospace\"];\n");
+
+  for (uint32_t i = 0; i < graph.blockCount; i++) {
+    const BasicBlock *block = &graph.blocks[i];
+
+    printf("  b%03X [label=\"%s_%03X\\l", block->start,
+           labelPrefix(block->start), block->start);
+    for (uint16_t pc = block->start; pc < block->end; pc += 2) {
+      disassemble(opcodeAt(pc), mnemonic, sizeof(mnemonic));
+      printf("%03X  %s\\l", pc, mnemonic);
+    }
+
+    // Self-modifying blocks in red, blocks running into data in orange
+    const char *color = "";
+    if (block->selfModifying) {
+      color = ", color=red";
+    } else if (block->exit == EXIT_INVALID) {
+      color = ", color=orange";
+    }
+    printf("\"%s];\n", color);
+
+    for (uint32_t j = 0; j < 2; j++) {
+      if (findBlock(&graph, block->successors[j]) != NULL) {
+        printf("  b%03X -> b%03X;\n", block->start, block->successors[j]);
+      }
+    }
+
+    if (block->exit == EXIT_CALL) {
+      printf("  b%03X -> b%03X [style=dashed];\n", block->start,
+             block->target);
+    } else if (block->exit == EXIT_INDIRECT) {
+      printf("  i%03X [label=\"0x%03X + V0\", shape=diamond];\n",
+             block->start, block->target);
+      printf("  b%03X -> i%03X [style=dotted];\n", block->start,
+             block->start);
+    }
+  }
+
+  printf("}\n");
+}
+
+int main(int argc, char *argv[]) {
+  const char *usage = "Usage: chip8-dis [-g] <rom>\n";
+  bool graphviz = false;
+  int32_t option;
+
+  while ((option = getopt(argc, argv, "g")) != -1) {
+    switch (option) {
+      case 'g':
+        graphviz = true;
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 1) {
+    fprintf(stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+
+  if (!loadRom(&chip8, argv[optind])) {
+    return EXIT_FAILURE;
+  }
+
+  analyzeRom(&graph, chip8.ram);
+
+  if (graphviz) {
+    printGraphviz(argv[optind]);
+  } else {
+    printListing(argv[optind]);
+  }
+
+  return EXIT_SUCCESS;
+}
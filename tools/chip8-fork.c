@@ -0,0 +1,274 @@
+#include "core.h"
+#include "manifest.h"
+#include "state.h"
+// std
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Limit of the input of a single request
+#define MAX_ROLLOUT_EVENTS 64
+
+// Pending connections before the server accepts them
+#define LISTEN_BACKLOG 64
+
+typedef struct {
+  uint32_t frames;
+  bool seeded;
+  uint32_t seed;
+  const char *statePath;
+  const char *framePath;
+  KeyEvent events[MAX_ROLLOUT_EVENTS];
+  uint32_t eventCount;
+} Rollout;
+
+// Warmed up once, every rollout forks from it and the kernel shares the
+// pages until a child writes to them
+static Chip8 chip8;
+static uint32_t instructionsPerFrame;
+static uint32_t timeout;
+
+// Parses the key=value options following the input
+static bool parseOption(Rollout *rollout, char *option) {
+  char *equals = strchr(option, '=');
+  if (equals == NULL) return false;
+
+  *equals = '\0';
+  const char *value = equals + 1;
+
+  if (strcmp(option, "seed") == 0) {
+    rollout->seeded = true;
+    rollout->seed = strtoul(value, NULL, 0);
+    return true;
+  }
+  if (strcmp(option, "state") == 0) {
+    rollout->statePath = value;
+    return true;
+  }
+  if (strcmp(option, "frame") == 0) {
+    rollout->framePath = value;
+    return true;
+  }
+
+  return false;
+}
+
+// Requests are a frame count, the input and options separated by
+// whitespace. Paths point into the line, which outlives the rollout
+static bool parseRollout(Rollout *rollout, char *line) {
+  char *save;
+  const char *frames = strtok_r(line, " \t\r\n", &save);
+  const char *input = strtok_r(NULL, " \t\r\n", &save);
+
+  *rollout = (Rollout){0};
+  if (frames == NULL || input == NULL) return false;
+
+  char *end;
+  rollout->frames = strtoul(frames, &end, 10);
+  if (*end != '\0' ||
+      !parseKeyEvents(input, rollout->events, MAX_ROLLOUT_EVENTS,
+                      &rollout->eventCount)) {
+    return false;
+  }
+
+  for (char *option = strtok_r(NULL, " \t\r\n", &save); option;
+       option = strtok_r(NULL, " \t\r\n", &save)) {
+    if (!parseOption(rollout, option)) return false;
+  }
+
+  return true;
+}
+
+// Runs in the forked child, which replies to the client itself and exits
+static void runRollout(const Rollout *rollout, const int connection) {
+  if (rollout->seeded) seedRandom(&chip8, rollout->seed);
+
+  uint32_t next = 0;
+
+  // Input frames count from 1, as in chip8-test manifests
+  for (uint32_t frame = 1; frame <= rollout->frames; frame++) {
+    applyKeyEvents(&chip8, rollout->events, rollout->eventCount, frame,
+                   &next);
+
+    runFrame(&chip8, instructionsPerFrame);
+    chip8.draw = false;
+  }
+
+  if ((rollout->statePath != NULL &&
+       !saveStateFile(&chip8, rollout->statePath)) ||
+      (rollout->framePath != NULL &&
+       !writeFrame(rollout->framePath, chip8.frameBuffer))) {
+    dprintf(connection, "error failed to write the results\n");
+    return;
+  }
+
+  dprintf(connection, "ok %llu %08X %08X %u\n",
+          (unsigned long long)chip8.cycles,
+          checksum(chip8.frameBuffer, sizeof(chip8.frameBuffer)),
+          checksum(&chip8, CHIP8_STATE_SIZE), chip8.soundTimer);
+}
+
+// Serves one client in a process of its own, forking again per request so
+// a rollout that crashes or runs out of time loses only its own reply
+static void serveConnection(const int connection) {
+  FILE *requests = fdopen(connection, "r");
+  char line[MANIFEST_LINE_SIZE];
+
+  while (fgets(line, sizeof(line), requests) != NULL) {
+    Rollout rollout;
+
+    if (!parseRollout(&rollout, line)) {
+      dprintf(connection, "error bad request\n");
+      continue;
+    }
+
+    const pid_t pid = fork();
+
+    if (pid == 0) {
+      alarm(timeout);
+      runRollout(&rollout, connection);
+      // The parent's buffered stdio must not be flushed twice
+      _exit(EXIT_SUCCESS);
+    }
+
+    if (pid < 0) {
+      dprintf(connection, "error fork failed\n");
+      continue;
+    }
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    if (WIFSIGNALED(status)) {
+      dprintf(connection, "crashed signal %d\n", WTERMSIG(status));
+    }
+  }
+
+  fclose(requests);
+}
+
+static int listenOn(const char *path) {
+  struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    return -1;
+  }
+  snprintf(address.sun_path, sizeof(address.sun_path), "%s", path);
+
+  const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0) {
+    perror("Failed to create socket");
+    return -1;
+  }
+
+  // A socket left behind by an earlier server would fail the bind
+  unlink(path);
+
+  // Rollouts write files wherever a request names, so only the owner may
+  // connect. The socket is created without group and other permissions
+  // rather than changed afterwards, leaving no window to connect in
+  const mode_t mask = umask(S_IRWXG | S_IRWXO);
+  const int bound = bind(server, (struct sockaddr *)&address, sizeof(address));
+  umask(mask);
+
+  if (bound < 0 || listen(server, LISTEN_BACKLOG) < 0) {
+    perror("Failed to listen on socket");
+    close(server);
+    return -1;
+  }
+
+  return server;
+}
+
+int main(int argc, char *argv[]) {
+  const char *usage =
+      "Usage: chip8-fork [-p profile] [-w frames | -s state] [-t seconds] "
+      "<socket> <rom>\n";
+  const char *profileName = NULL;
+  const char *statePath = NULL;
+  uint32_t warmup = 0;
+  int32_t option;
+
+  while ((option = getopt(argc, argv, "p:w:s:t:")) != -1) {
+    switch (option) {
+      case 'p':
+        profileName = optarg;
+        break;
+      case 'w':
+        warmup = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        statePath = optarg;
+        break;
+      case 't':
+        timeout = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 2 || (warmup && statePath != NULL)) {
+    fprintf(stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+
+  Config config = {0};
+  defaultConfig(&config);
+  instructionsPerFrame = config.instructionsPerSecond / FRAME_RATE;
+
+  if (profileName != NULL && !parseProfile(profileName, &config.profile)) {
+    fprintf(stderr, "Unknown profile: %s\n", profileName);
+    return EXIT_FAILURE;
+  }
+
+  resetChip8(&chip8);
+  setProfile(&chip8, config.profile);
+  if (!loadRom(&chip8, argv[optind + 1])) return EXIT_FAILURE;
+  if (statePath != NULL && !loadStateFile(&chip8, statePath)) {
+    return EXIT_FAILURE;
+  }
+  chip8.state = RUNNING;
+
+  for (uint32_t frame = 0; frame < warmup; frame++) {
+    runFrame(&chip8, instructionsPerFrame);
+    chip8.draw = false;
+  }
+
+  const int server = listenOn(argv[optind]);
+  if (server < 0) return EXIT_FAILURE;
+
+  // Connection processes are reaped by the kernel, and a client hanging up
+  // mid reply must not kill the process writing it
+  signal(SIGCHLD, SIG_IGN);
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("Serving rollouts on %s\n", argv[optind]);
+  fflush(stdout);
+
+  for (;;) {
+    const int connection = accept(server, NULL, NULL);
+    if (connection < 0) continue;
+
+    const pid_t pid = fork();
+
+    if (pid == 0) {
+      close(server);
+      // Rollouts are waited for, which ignoring SIGCHLD would prevent
+      signal(SIGCHLD, SIG_DFL);
+      serveConnection(connection);
+      _exit(EXIT_SUCCESS);
+    }
+
+    if (pid < 0) perror("Failed to fork");
+    close(connection);
+  }
+}
@@ -0,0 +1,68 @@
+#include "core.h"
+// std
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Every input runs for a bounded number of cycles
+#define FUZZ_FRAMES 16
+#define FUZZ_INSTRUCTIONS_PER_FRAME 128
+
+// Input layout: a profile byte, an event count byte, that many keypad
+// events of a frame byte and two keypad bytes, then the rom
+#define FUZZ_HEADER_SIZE 2
+#define FUZZ_EVENT_SIZE 3
+
+// Reset for every input instead of reinitialised
+static Chip8 chip8;
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < FUZZ_HEADER_SIZE) return 0;
+
+  const uint8_t eventCount = data[1];
+  const uint8_t *events = &data[FUZZ_HEADER_SIZE];
+  const size_t romOffset = FUZZ_HEADER_SIZE + eventCount * FUZZ_EVENT_SIZE;
+  if (size < romOffset) return 0;
+
+  resetChip8(&chip8);
+  setProfile(&chip8, data[0] % PROFILE_COUNT);
+  if (!loadRomData(&chip8, &data[romOffset], size - romOffset)) return 0;
+
+  for (uint32_t frame = 0; frame < FUZZ_FRAMES; frame++) {
+    // Apply the keypad events scripted for the frame in input order
+    for (uint32_t i = 0; i < eventCount; i++) {
+      const uint8_t *event = &events[i * FUZZ_EVENT_SIZE];
+      if (event[0] % FUZZ_FRAMES == frame) {
+        setKeypadState(&chip8, event[1] | event[2] << 8);
+      }
+    }
+
+    runFrame(&chip8, FUZZ_INSTRUCTIONS_PER_FRAME);
+  }
+
+  return 0;
+}
+
+#ifdef CHIP8_FUZZ_MAIN
+// Runs the given inputs once each, to reproduce a crash without libFuzzer
+int main(int argc, char *argv[]) {
+  static uint8_t input[FUZZ_HEADER_SIZE + 0xFF * FUZZ_EVENT_SIZE + RAM_SIZE];
+
+  for (int32_t i = 1; i < argc; i++) {
+    FILE *file = fopen(argv[i], "rb");
+
+    if (file == NULL) {
+      fprintf(stderr, "Failed to open input file: %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+
+    const size_t size = fread(input, 1, sizeof(input), file);
+    fclose(file);
+
+    LLVMFuzzerTestOneInput(input, size);
+  }
+
+  return EXIT_SUCCESS;
+}
+#endif
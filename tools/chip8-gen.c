@@ -0,0 +1,451 @@
+#include "core.h"
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Roms generated unless given with -n, and units of code in each with -l
+#define DEFAULT_COUNT 1
+#define DEFAULT_LENGTH 256
+
+// Subroutine nesting unless given with -d, the original interpreter has
+// 16 stack entries and the main program uses none
+#define DEFAULT_DEPTH 4
+#define MAX_DEPTH 15
+
+// Sprite rows to draw from and bytes for the stores to write to
+#define SPRITE_DATA_SIZE 32
+#define SCRATCH_SIZE 16
+
+// BNNN tables stay below 0xE00, so the register the jump quirk adds is
+// never the loop counter VE or the flag register VF
+#define CODE_LIMIT 0xD80
+
+// Entries of a BNNN jump table
+#define MAX_TABLE_SIZE 8
+
+// Generated code writes V0-VD, VE counts the iterations and VF is only
+// written as a flag
+#define LAST_REGISTER 0xD
+#define COUNTER 0xE
+
+// Kinds of code a rom is generated from
+typedef enum {
+  UNIT_ALU = 0,   // Arithmetic, logic, loads and timers
+  UNIT_SKIP,      // Skip over an arithmetic instruction
+  UNIT_SPRITE,    // ANNN then DXYN, or 00E0
+  UNIT_MEMORY,    // ANNN then FX33, FX55 or FX65
+  UNIT_CALL,      // 2NNN into a chain of nested subroutines
+  UNIT_SMC,       // FX55 over the next instruction before executing it
+  UNIT_INDIRECT,  // BNNN through a jump table
+  UNIT_COUNT
+} Unit;
+
+static const char *unitNames[UNIT_COUNT] = {
+    [UNIT_ALU] = "alu",       [UNIT_SKIP] = "skip", [UNIT_SPRITE] = "sprite",
+    [UNIT_MEMORY] = "memory", [UNIT_CALL] = "call", [UNIT_SMC] = "smc",
+    [UNIT_INDIRECT] = "indirect",
+};
+
+// Relative frequency of every kind of unit
+typedef struct {
+  uint32_t weights[UNIT_COUNT];
+} Mix;
+
+typedef struct {
+  const char *name;
+  Mix mix;
+} Preset;
+
+static const Preset presets[] = {
+    {"balanced", {{8, 2, 2, 2, 1, 0, 0}}},
+    {"alu", {{16, 2, 1, 1, 0, 0, 0}}},
+    {"sprite", {{2, 1, 8, 1, 0, 0, 0}}},
+    {"call", {{4, 1, 1, 1, 8, 0, 0}}},
+    {"smc", {{4, 1, 1, 1, 0, 4, 0}}},
+    {"indirect", {{4, 1, 1, 1, 0, 0, 4}}},
+    {"all", {{8, 2, 2, 2, 2, 2, 2}}},
+};
+
+#define PRESET_COUNT (sizeof(presets) / sizeof(*presets))
+
+// Rom being generated, code is emitted at address
+typedef struct {
+  uint8_t data[RAM_SIZE - PROGRAM_START];
+  uint16_t address;
+  uint32_t random;
+  // Fixed locations every unit refers to
+  uint16_t spriteData;
+  uint16_t scratch;
+  uint16_t subroutines[MAX_DEPTH];
+} Rom;
+
+static uint32_t nextRandom(Rom *rom) {
+  // Xorshift, never zero when seeded with a non-zero value
+  rom->random ^= rom->random << 13;
+  rom->random ^= rom->random >> 17;
+  rom->random ^= rom->random << 5;
+  return rom->random;
+}
+
+static uint32_t randomBelow(Rom *rom, const uint32_t limit) {
+  return nextRandom(rom) % limit;
+}
+
+static void emit(Rom *rom, const uint16_t opcode) {
+  rom->data[rom->address - PROGRAM_START] = opcode >> 8;
+  rom->data[rom->address - PROGRAM_START + 1] = opcode & 0xFF;
+  rom->address += 2;
+}
+
+static uint8_t randomRegister(Rom *rom) {
+  return randomBelow(rom, LAST_REGISTER + 1);
+}
+
+// Any instruction that neither transfers control nor needs I to be known
+static uint16_t aluOpcode(Rom *rom) {
+  static const uint16_t arithmetic[] = {0x0, 0x1, 0x2, 0x3, 0x4,
+                                        0x5, 0x6, 0x7, 0xE};
+  static const uint16_t timers[] = {0x07, 0x15, 0x18};
+  const uint16_t x = randomRegister(rom) << 8;
+  // Sources may read the loop counter and the flags as well, so the flags
+  // reach the registers sprites are drawn at
+  const uint16_t y = randomBelow(rom, 0x10) << 4;
+  const uint16_t kk = randomBelow(rom, 0x100);
+
+  switch (randomBelow(rom, 8)) {
+    case 0:
+    case 1:
+      return 0x6000 | x | kk;
+    case 2:
+    case 3:
+      return 0x7000 | x | kk;
+    case 4:
+      return 0xF000 | x | timers[randomBelow(rom, 3)];
+    default:
+      return 0x8000 | x | y | arithmetic[randomBelow(rom, 9)];
+  }
+}
+
+static void emitSkip(Rom *rom) {
+  static const uint16_t skips[] = {0x3000, 0x4000, 0x5000,
+                                   0x9000, 0xE09E, 0xE0A1};
+  const uint16_t skip = skips[randomBelow(rom, 6)];
+  const uint16_t x = randomBelow(rom, COUNTER + 1) << 8;
+
+  if (skip >> 12 == 0x5 || skip >> 12 == 0x9) {
+    emit(rom, skip | x | randomBelow(rom, COUNTER + 1) << 4);
+  } else if (skip >> 12 == 0xE) {
+    // Key skips read a key number, loaded into a register the code writes
+    const uint16_t key = randomRegister(rom) << 8;
+    emit(rom, 0x6000 | key | randomBelow(rom, KEYS));
+    emit(rom, skip | key);
+  } else {
+    emit(rom, skip | x | randomBelow(rom, 0x100));
+  }
+
+  // The skipped instruction is never a jump, so either path rejoins
+  emit(rom, aluOpcode(rom));
+}
+
+static void emitSprite(Rom *rom) {
+  if (randomBelow(rom, 8) == 0) {
+    emit(rom, 0x00E0);
+    return;
+  }
+
+  // Up to 15 rows from anywhere in the first half of the sprite data
+  const uint16_t rows = randomBelow(rom, 15) + 1;
+  emit(rom, 0xA000 | (rom->spriteData + randomBelow(rom, 16)));
+  emit(rom, 0xD000 | randomRegister(rom) << 8 | randomRegister(rom) << 4 |
+                rows);
+}
+
+static void emitMemory(Rom *rom) {
+  emit(rom, 0xA000 | rom->scratch);
+
+  switch (randomBelow(rom, 3)) {
+    case 0:
+      emit(rom, 0xF033 | randomBelow(rom, COUNTER + 1) << 8);
+      break;
+    case 1:
+      emit(rom, 0xF055 | randomBelow(rom, 0x10) << 8);
+      break;
+    default:
+      // Loading stops short of the loop counter
+      emit(rom, 0xF065 | randomRegister(rom) << 8);
+      break;
+  }
+}
+
+static void emitCall(Rom *rom, const uint32_t depth) {
+  // Enter the chain at a random level, nesting up to the deepest
+  emit(rom, 0x2000 | rom->subroutines[randomBelow(rom, depth)]);
+}
+
+static void emitSelfModifying(Rom *rom) {
+  // Store an instruction over the one following the store
+  const uint16_t patch = aluOpcode(rom);
+  emit(rom, 0xA000 | (rom->address + 8));
+  emit(rom, 0x6000 | patch >> 8);
+  emit(rom, 0x6100 | (patch & 0xFF));
+  emit(rom, 0xF155);
+  emit(rom, aluOpcode(rom));
+}
+
+static void emitIndirect(Rom *rom) {
+  const uint16_t size = randomBelow(rom, MAX_TABLE_SIZE) + 1;
+  const uint16_t entry = randomBelow(rom, size) * 2;
+  const uint16_t table = rom->address + 6;
+  const uint16_t end = table + size * 2;
+
+  // V0 and the register the jump quirk uses both hold the offset, so the
+  // jump lands on the same entry with either behaviour
+  emit(rom, 0x6000 | entry);
+  emit(rom, 0x6000 | (table & 0x0F00) | entry);
+  emit(rom, 0xB000 | table);
+
+  for (uint32_t i = 0; i < size; i++) {
+    emit(rom, 0x1000 | end);
+  }
+}
+
+// Largest unit, emitted only while it fits below CODE_LIMIT
+#define MAX_UNIT_SIZE (6 + MAX_TABLE_SIZE * 2)
+
+static void emitSubroutines(Rom *rom, const uint32_t depth) {
+  for (uint32_t level = 0; level < depth; level++) {
+    rom->subroutines[level] = rom->address;
+
+    const uint32_t count = randomBelow(rom, 3) + 1;
+    for (uint32_t i = 0; i < count; i++) {
+      emit(rom, aluOpcode(rom));
+    }
+
+    // The next level follows directly
+    if (level + 1 < depth) emit(rom, 0x2000 | (rom->address + 4));
+    emit(rom, 0x00EE);
+  }
+}
+
+static Unit pickUnit(Rom *rom, const Mix *mix, const uint32_t total) {
+  uint32_t pick = randomBelow(rom, total);
+
+  for (uint32_t unit = 0; unit < UNIT_COUNT; unit++) {
+    if (pick < mix->weights[unit]) return unit;
+    pick -= mix->weights[unit];
+  }
+
+  return UNIT_ALU;
+}
+
+// Lays out a jump over the data and subroutines, the counter, the units
+// and the tail looping forever or halting after the iterations
+static uint16_t generateRom(Rom *rom, const Mix *mix, const uint32_t seed,
+                            const uint32_t length, const uint32_t depth,
+                            const uint32_t iterations) {
+  memset(rom, 0, sizeof(*rom));
+  rom->random = seed * 2654435761u | 1;
+  rom->address = PROGRAM_START + 2;
+
+  rom->spriteData = rom->address;
+  for (uint32_t i = 0; i < SPRITE_DATA_SIZE; i++) {
+    rom->data[rom->address++ - PROGRAM_START] = randomBelow(rom, 0x100);
+  }
+
+  rom->scratch = rom->address;
+  rom->address += SCRATCH_SIZE;
+
+  if (mix->weights[UNIT_CALL]) emitSubroutines(rom, depth);
+
+  const uint16_t start = rom->address;
+  rom->address = PROGRAM_START;
+  emit(rom, 0x1000 | start);
+  rom->address = start;
+
+  if (iterations) emit(rom, 0x6000 | COUNTER << 8 | iterations);
+  const uint16_t body = rom->address;
+
+  uint32_t total = 0;
+  for (uint32_t unit = 0; unit < UNIT_COUNT; unit++) {
+    total += mix->weights[unit];
+  }
+
+  for (uint32_t i = 0;
+       i < length && rom->address + MAX_UNIT_SIZE <= CODE_LIMIT; i++) {
+    switch (pickUnit(rom, mix, total)) {
+      case UNIT_ALU:
+        emit(rom, aluOpcode(rom));
+        break;
+      case UNIT_SKIP:
+        emitSkip(rom);
+        break;
+      case UNIT_SPRITE:
+        emitSprite(rom);
+        break;
+      case UNIT_MEMORY:
+        emitMemory(rom);
+        break;
+      case UNIT_CALL:
+        emitCall(rom, depth);
+        break;
+      case UNIT_SMC:
+        emitSelfModifying(rom);
+        break;
+      case UNIT_INDIRECT:
+        emitIndirect(rom);
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (iterations) {
+    // Count down and halt on a jump to itself once the counter reaches 0
+    emit(rom, 0x7000 | COUNTER << 8 | 0xFF);
+    emit(rom, 0x3000 | COUNTER << 8);
+    emit(rom, 0x1000 | body);
+    emit(rom, 0x1000 | rom->address);
+  } else {
+    emit(rom, 0x1000 | body);
+  }
+
+  return rom->address - PROGRAM_START;
+}
+
+// Parses a preset name or a comma separated list of presets and
+// unit=weight pairs, later entries overriding earlier ones
+static bool parseMix(const char *text, Mix *mix) {
+  char copy[256];
+  snprintf(copy, sizeof(copy), "%s", text);
+
+  for (char *token = strtok(copy, ","); token; token = strtok(NULL, ",")) {
+    char *equals = strchr(token, '=');
+    bool found = false;
+
+    if (equals == NULL) {
+      for (uint32_t i = 0; i < PRESET_COUNT && !found; i++) {
+        if (strcmp(token, presets[i].name) == 0) {
+          *mix = presets[i].mix;
+          found = true;
+        }
+      }
+    } else {
+      *equals = '\0';
+      for (uint32_t unit = 0; unit < UNIT_COUNT && !found; unit++) {
+        if (strcmp(token, unitNames[unit]) == 0) {
+          mix->weights[unit] = strtoul(equals + 1, NULL, 0);
+          found = true;
+        }
+      }
+    }
+
+    if (!found) {
+      fprintf(stderr, "Unknown mix: %s\n", token);
+      return false;
+    }
+  }
+
+  for (uint32_t unit = 0; unit < UNIT_COUNT; unit++) {
+    if (mix->weights[unit]) return true;
+  }
+
+  fprintf(stderr, "Mix has no weights: %s\n", text);
+  return false;
+}
+
+static bool writeRom(const char *path, const uint8_t *header,
+                     const size_t headerSize, const Rom *rom,
+                     const uint16_t size) {
+  FILE *file = fopen(path, "wb");
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open rom file: %s\n", path);
+    return false;
+  }
+
+  const bool written = fwrite(header, 1, headerSize, file) == headerSize &&
+                       fwrite(rom->data, 1, size, file) == size;
+  fclose(file);
+
+  if (!written) {
+    fprintf(stderr, "Failed to write rom file: %s\n", path);
+    return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  const char *usage =
+      "Usage: chip8-gen [-m mix] [-s seed] [-n count] [-l length] "
+      "[-d depth] [-i iterations] [-f] <rom|directory>\n";
+  Mix mix = presets[0].mix;
+  uint32_t seed = 1;
+  uint32_t count = DEFAULT_COUNT;
+  uint32_t length = DEFAULT_LENGTH;
+  uint32_t depth = DEFAULT_DEPTH;
+  uint32_t iterations = 0;
+  bool fuzz = false;
+  int32_t option;
+
+  while ((option = getopt(argc, argv, "m:s:n:l:d:i:f")) != -1) {
+    switch (option) {
+      case 'm':
+        if (!parseMix(optarg, &mix)) return EXIT_FAILURE;
+        break;
+      case 's':
+        seed = strtoul(optarg, NULL, 0);
+        break;
+      case 'n':
+        count = strtoul(optarg, NULL, 0);
+        break;
+      case 'l':
+        length = strtoul(optarg, NULL, 0);
+        break;
+      case 'd':
+        depth = strtoul(optarg, NULL, 0);
+        break;
+      case 'i':
+        iterations = strtoul(optarg, NULL, 0);
+        break;
+      case 'f':
+        fuzz = true;
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 1 || count == 0 || depth == 0 || depth > MAX_DEPTH ||
+      iterations > 0xFF) {
+    fprintf(stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+
+  static Rom rom;
+  char path[FILENAME_MAX];
+
+  for (uint32_t i = 0; i < count; i++) {
+    const uint16_t size =
+        generateRom(&rom, &mix, seed + i, length, depth, iterations);
+
+    // Fuzzing inputs start with a profile byte and no keypad events
+    const uint8_t header[2] = {i % PROFILE_COUNT, 0};
+    const size_t headerSize = fuzz ? sizeof(header) : 0;
+
+    // A single rom is written to the path, a corpus into the directory
+    if (count == 1) {
+      snprintf(path, sizeof(path), "%s", argv[optind]);
+    } else {
+      snprintf(path, sizeof(path), "%s/%05u.%s", argv[optind], seed + i,
+               fuzz ? "bin" : "ch8");
+    }
+
+    if (!writeRom(path, header, headerSize, &rom, size)) return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,374 @@
+#include "core.h"
+#include "manifest.h"
+#include "state.h"
+// std
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Limits of a single manifest line
+#define MAX_TEST_EVENTS 64
+#define MAX_CHECKPOINTS 32
+
+// Columns between the panels of a diff image
+#define DIFF_GAP 2
+#define DIFF_WIDTH (WINDOW_WIDTH * 3 + DIFF_GAP * 2)
+
+// Framebuffer hash expected after the given number of frames
+typedef struct {
+  uint32_t frame;
+  uint32_t hash;
+} Checkpoint;
+
+typedef struct {
+  char *romPath;
+  char *profileName;
+  char *input;
+  Profile profile;
+  uint32_t line;
+  KeyEvent events[MAX_TEST_EVENTS];
+  uint32_t eventCount;
+  Checkpoint checkpoints[MAX_CHECKPOINTS];
+  uint32_t checkpointCount;
+  // Filled in by the worker running the test
+  bool loaded;
+  bool passed;
+  uint32_t failedCheckpoint;
+  uint32_t hashes[MAX_CHECKPOINTS];
+  char diffPath[FILENAME_MAX];
+} Test;
+
+static Test *tests;
+static uint32_t testCount;
+static atomic_uint nextTest;
+
+static uint32_t instructionsPerFrame;
+static const char *imageDirectory;
+static bool updating;
+
+static bool parseCheckpoint(Test *test, const char *text) {
+  const char *colon = strchr(text, ':');
+
+  if (test->checkpointCount == MAX_CHECKPOINTS || colon == NULL) return false;
+
+  Checkpoint *checkpoint = &test->checkpoints[test->checkpointCount++];
+  checkpoint->frame = strtoul(text, NULL, 10);
+  // New checkpoints may be written as frame:0 until the manifest is updated
+  checkpoint->hash = strtoul(colon + 1, NULL, 16);
+
+  // Frames are counted from 1 and only move forward
+  return test->checkpointCount == 1
+             ? checkpoint->frame > 0
+             : checkpoint->frame >
+                   test->checkpoints[test->checkpointCount - 2].frame;
+}
+
+// Lines are a rom, a profile, the input and the checkpoints. Frame 0 of the
+// input is the same as frame 1
+static bool loadManifest(const char *path) {
+  Manifest manifest;
+  if (!openManifest(&manifest, path)) return false;
+
+  uint32_t capacity = 0;
+  bool valid = true;
+  char *romPath;
+
+  while (valid && (romPath = nextManifestLine(&manifest)) != NULL) {
+    if (testCount == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      tests = realloc(tests, capacity * sizeof(Test));
+    }
+
+    Test *test = &tests[testCount++];
+    memset(test, 0, sizeof(*test));
+    test->line = manifest.lineNumber;
+    test->romPath = strdup(romPath);
+
+    char *profileName = nextManifestField(&manifest);
+    char *input = nextManifestField(&manifest);
+    valid = profileName != NULL && input != NULL &&
+            parseProfile(profileName, &test->profile) &&
+            parseKeyEvents(input, test->events, MAX_TEST_EVENTS,
+                           &test->eventCount);
+
+    if (valid) {
+      test->profileName = strdup(profileName);
+      test->input = strdup(input);
+    }
+
+    for (char *token = nextManifestField(&manifest); valid && token;
+         token = nextManifestField(&manifest)) {
+      valid = parseCheckpoint(test, token);
+    }
+
+    if (!valid || test->checkpointCount == 0) {
+      fprintf(stderr, "Invalid test on line %u of %s\n", manifest.lineNumber,
+              path);
+      valid = false;
+    }
+  }
+
+  closeManifest(&manifest);
+
+  return valid;
+}
+
+// Plain PBM with the expected frame, the actual frame and the pixels that
+// differ side by side
+static bool writeDiffImage(const char *path, const uint8_t *expected,
+                           const uint8_t *actual) {
+  FILE *file = fopen(path, "w");
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open diff image: %s\n", path);
+    return false;
+  }
+
+  fprintf(file, "P1\n%u %u\n", DIFF_WIDTH, WINDOW_HEIGHT);
+
+  for (uint32_t y = 0; y < WINDOW_HEIGHT; y++) {
+    for (uint32_t x = 0; x < DIFF_WIDTH; x++) {
+      const uint32_t panel = x / (WINDOW_WIDTH + DIFF_GAP);
+      const uint32_t column = x % (WINDOW_WIDTH + DIFF_GAP);
+      const uint32_t i = y * WINDOW_WIDTH + column;
+      uint8_t pixel = 0;
+
+      if (column < WINDOW_WIDTH) {
+        if (panel == 0) pixel = expected != NULL && expected[i];
+        if (panel == 1) pixel = actual[i];
+        if (panel == 2) pixel = expected == NULL || expected[i] != actual[i];
+      }
+
+      fputc(pixel ? '1' : '0', file);
+      fputc(x + 1 < DIFF_WIDTH ? ' ' : '\n', file);
+    }
+  }
+
+  fclose(file);
+
+  return true;
+}
+
+// Golden frames and diff images are named after the rom, the manifest
+// line and the frame
+static void imagePath(char *path, const size_t size, const Test *test,
+                      const uint32_t frame, const char *suffix) {
+  const char *name = strrchr(test->romPath, '/');
+  name = name != NULL ? name + 1 : test->romPath;
+
+  snprintf(path, size, "%s/%s.%u.%u%s.pbm", imageDirectory, name, test->line,
+           frame, suffix);
+}
+
+static void runTest(Test *test, Chip8 *chip8) {
+  resetChip8(chip8);
+  setProfile(chip8, test->profile);
+
+  test->loaded = loadRom(chip8, test->romPath);
+  if (!test->loaded) return;
+
+  const uint32_t frames =
+      test->checkpoints[test->checkpointCount - 1].frame;
+  uint32_t event = 0;
+  uint32_t checkpoint = 0;
+
+  test->passed = true;
+
+  for (uint32_t frame = 1; frame <= frames; frame++) {
+    applyKeyEvents(chip8, test->events, test->eventCount, frame, &event);
+
+    runFrame(chip8, instructionsPerFrame);
+
+    if (test->checkpoints[checkpoint].frame != frame) continue;
+
+    const uint32_t hash =
+        checksum(chip8->frameBuffer, sizeof(chip8->frameBuffer));
+    test->hashes[checkpoint] = hash;
+
+    char path[FILENAME_MAX];
+    if (updating && imageDirectory != NULL) {
+      imagePath(path, sizeof(path), test, frame, "");
+      writeFrame(path, chip8->frameBuffer);
+    }
+
+    // Every checkpoint is hashed when updating, testing stops at the first
+    // mismatch
+    if (!updating && hash != test->checkpoints[checkpoint].hash) {
+      test->passed = false;
+      test->failedCheckpoint = checkpoint;
+
+      if (imageDirectory != NULL) {
+        uint8_t golden[WINDOW_WIDTH * WINDOW_HEIGHT];
+        imagePath(path, sizeof(path), test, frame, "");
+        const bool found = readFrame(path, golden);
+
+        imagePath(test->diffPath, sizeof(test->diffPath), test, frame,
+                  ".diff");
+        writeDiffImage(test->diffPath, found ? golden : NULL,
+                       chip8->frameBuffer);
+      }
+      return;
+    }
+
+    checkpoint++;
+  }
+}
+
+static void *runTests(void *argument) {
+  (void)argument;
+  Chip8 *chip8 = calloc(1, sizeof(Chip8));
+
+  for (uint32_t i = atomic_fetch_add(&nextTest, 1); i < testCount;
+       i = atomic_fetch_add(&nextTest, 1)) {
+    runTest(&tests[i], chip8);
+  }
+
+  free(chip8);
+
+  return NULL;
+}
+
+// Prints the manifest with the hashes just computed, keeping comments, blank
+// lines and the tests whose rom did not load as they were, so the line
+// numbers naming the golden frames stay the same
+static bool printManifest(const char *path) {
+  FILE *file = fopen(path, "r");
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open manifest: %s\n", path);
+    return false;
+  }
+
+  char line[MANIFEST_LINE_SIZE];
+  uint32_t lineNumber = 0;
+  uint32_t i = 0;
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    lineNumber++;
+
+    if (i == testCount || tests[i].line != lineNumber) {
+      fputs(line, stdout);
+      continue;
+    }
+
+    const Test *test = &tests[i++];
+    if (!test->loaded) {
+      fputs(line, stdout);
+      continue;
+    }
+
+    printf("%s %s %s", test->romPath, test->profileName, test->input);
+    for (uint32_t j = 0; j < test->checkpointCount; j++) {
+      printf(" %u:%08X", test->checkpoints[j].frame, test->hashes[j]);
+    }
+    printf("\n");
+  }
+
+  fclose(file);
+
+  return true;
+}
+
+static uint32_t reportLoadFailures(void) {
+  uint32_t failed = 0;
+
+  for (uint32_t i = 0; i < testCount; i++) {
+    if (tests[i].loaded) continue;
+
+    fprintf(stderr, "Skipped %s(line %u): rom not loaded\n", tests[i].romPath,
+            tests[i].line);
+    failed++;
+  }
+
+  return failed;
+}
+
+static uint32_t reportResults(void) {
+  uint32_t failed = 0;
+
+  for (uint32_t i = 0; i < testCount; i++) {
+    const Test *test = &tests[i];
+
+    if (test->passed) {
+      printf("PASS %s(line %u)\n", test->romPath, test->line);
+      continue;
+    }
+
+    failed++;
+
+    if (!test->loaded) {
+      printf("FAIL %s(line %u): rom not loaded\n", test->romPath, test->line);
+      continue;
+    }
+
+    const Checkpoint *checkpoint = &test->checkpoints[test->failedCheckpoint];
+    printf("FAIL %s(line %u): frame %u expected %08X got %08X", test->romPath,
+           test->line, checkpoint->frame, checkpoint->hash,
+           test->hashes[test->failedCheckpoint]);
+    if (test->diffPath[0]) printf(", diff in %s", test->diffPath);
+    printf("\n");
+  }
+
+  printf("%u passed, %u failed\n", testCount - failed, failed);
+
+  return failed;
+}
+
+int main(int argc, char *argv[]) {
+  const char *usage =
+      "Usage: chip8-test [-j threads] [-d directory] [-u] <manifest>\n";
+  long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+  int32_t option;
+
+  while ((option = getopt(argc, argv, "j:d:u")) != -1) {
+    switch (option) {
+      case 'j':
+        threadCount = strtol(optarg, NULL, 0);
+        break;
+      case 'd':
+        imageDirectory = optarg;
+        break;
+      case 'u':
+        updating = true;
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 1 || threadCount < 1) {
+    fprintf(stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+
+  if (!loadManifest(argv[optind])) return EXIT_FAILURE;
+
+  Config config = {0};
+  defaultConfig(&config);
+  instructionsPerFrame = config.instructionsPerSecond / FRAME_RATE;
+
+  // Tests are taken in manifest order by whichever thread is free
+  if (threadCount > testCount) threadCount = testCount;
+  pthread_t *threads = calloc(threadCount, sizeof(pthread_t));
+
+  for (long i = 0; i < threadCount; i++) {
+    pthread_create(&threads[i], NULL, runTests, NULL);
+  }
+
+  for (long i = 0; i < threadCount; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+
+  if (updating) {
+    const bool printed = printManifest(argv[optind]);
+    return reportLoadFailures() || !printed ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  return reportResults() ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+#include "disasm.h"
+#include "trace.h"
+// std
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  const char *usage = "Usage: chip8-trace [-a start-end] <trace>\n";
+  uint32_t start = 0;
+  uint32_t end = RAM_SIZE - 1;
+  int32_t option;
+
+  while ((option = getopt(argc, argv, "a:")) != -1) {
+    switch (option) {
+      case 'a':
+        // Inclusive hexadecimal address range
+        if (sscanf(optarg, "%x-%x", &start, &end) != 2 || start > end) {
+          fprintf(stderr, "Invalid address range: %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 1) {
+    fprintf(stderr, "%s", usage);
+    return EXIT_FAILURE;
+  }
+
+  FILE *file = fopen(argv[optind], "rb");
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open trace file: %s\n", argv[optind]);
+    return EXIT_FAILURE;
+  }
+
+  TraceHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      header.magic != TRACE_MAGIC || header.version != TRACE_VERSION ||
+      header.recordSize != sizeof(TraceRecord)) {
+    fprintf(stderr, "Invalid trace file: %s\n", argv[optind]);
+    fclose(file);
+    return EXIT_FAILURE;
+  }
+
+  TraceRecord record;
+  char mnemonic[32];
+
+  for (uint64_t i = 0; i < header.count; i++) {
+    if (fread(&record, sizeof(record), 1, file) != 1) {
+      fprintf(stderr, "Truncated trace file: %s\n", argv[optind]);
+      break;
+    }
+
+    if (record.programCounter < start || record.programCounter > end) {
+      continue;
+    }
+
+    disassemble(record.opcode, mnemonic, sizeof(mnemonic));
+    printf("%12llu  %03X  %04X  %-16s I=%03X V%X=%02X VF=%02X\n",
+           (unsigned long long)record.cycle, record.programCounter,
+           record.opcode, mnemonic, record.indexRegister,
+           (record.opcode >> 8) & 0xF, record.vx, record.vf);
+  }
+
+  fclose(file);
+
+  return EXIT_SUCCESS;
+}